@@ -1,126 +1,3969 @@
+#define _GNU_SOURCE // fopencookie of -O and -Q rings
 #include <stdio.h>
 #include <stdint.h>
+#include <float.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+#ifdef __x86_64__
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <libgen.h>
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 
 
+// "00" .. "ff"
+char hex_lut[512];
+
+void hex_init(void) {
+	const char* x = "0123456789abcdef";
+	for (int i = 0; i < 256; i++) {
+		hex_lut[i*2] = x[i >> 4];
+		hex_lut[i*2+1] = x[i & 15];
+	}
+}
+
+/*
+ * Format one hexdump line of up to 16 bytes into o (at least 96 bytes).
+ * Byte with mark[j] set gets '|' instead of ' ' in front of it.
+ * Returns line length incl new line.
+ */
+size_t hexline(char* o, uint64_t off, const uint8_t* d, size_t n, const uint8_t* mark) {
+	char* p = o;
+	int w = 8;
+	while (w < 16 && (off >> (w * 4))) w++;
+	for (int s = w - 1; s >= 0; s--) *p++ = "0123456789abcdef"[(off >> (s * 4)) & 15];
+
+	for (size_t j = 0; j < n; j++) {
+		*p++ = mark && mark[j] ? '|' : ' ';
+		memcpy (p, &hex_lut[d[j]*2], 2);
+		p += 2;
+	}
+	memset (p, ' ', (16 - n) * 3 + 1);
+	p += (16 - n) * 3 + 1;
+	for (size_t j = 0; j < n; j++) *p++ = d[j] >= ' ' && d[j] <= '~' ? d[j] : '.';
+	memset (p, ' ', 16 - n);
+	p += 16 - n;
+	*p++ = '\n';
+	return p - o;
+}
+
 void hexdump (void* x, size_t len) {
 	uint8_t* d = x;
+	char line[96];
+	if (hex_lut[0] == 0) hex_init ();
 	for (size_t i=0; i<len; i+=16) {
-		fprintf (stderr, "%.8lx ", i);
-		size_t j;
-		for (j=i; j<i+16 && j<len; j++) fprintf (stderr, "%.2x ", d[j]);
-		for (; j<i+16; j++) fprintf (stderr, "   ");
-		for (j=i; j<i+16 && j<len; j++) fprintf (stderr, "%c", d[j]>=' '&&d[j]<='~'?d[j]:'.');
-		for (; j<i+16; j++) fprintf (stderr, " ");
-		fprintf (stderr, "\n");
+		fwrite (line, hexline (line, i, d + i, len - i < 16 ? len - i : 16, NULL), 1, stderr);
+	}
+}
+
+
+// host byte order, '@' always means this one
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_ENDIAN '>'
+#else
+#define HOST_ENDIAN '<'
+#endif
+
+// convert count elements of size l between e byte order and host byte order
+void endian(char e, void* d, size_t l, uint32_t count) {
+	uint8_t* x = (uint8_t*)d;
+	if (x == NULL) return;
+	if (e == '@' || e == HOST_ENDIAN) return;
+
+	switch (l) {
+		case 2:
+			for (uint16_t y; count; count--, x += 2) {
+				memcpy (&y, x, 2);
+				y = __builtin_bswap16 (y);
+				memcpy (x, &y, 2);
+			}
+			break;
+		case 4:
+			for (uint32_t y; count; count--, x += 4) {
+				memcpy (&y, x, 4);
+				y = __builtin_bswap32 (y);
+				memcpy (x, &y, 4);
+			}
+			break;
+		case 8:
+			for (uint64_t y; count; count--, x += 8) {
+				memcpy (&y, x, 8);
+				y = __builtin_bswap64 (y);
+				memcpy (x, &y, 8);
+			}
+			break;
+	}
+}
+
+// CRC32C (Castagnoli) slicing by 8 tables, crc_hw set when cpu has crc32
+// instruction, crc_fold when it has pclmul too, crc_k its shift constants
+uint32_t crc_lut[8][256];
+int crc_hw, crc_fold;
+uint32_t crc_k[2];
+
+// bytes of each of 3 crc32 instruction streams of a long span
+#define CRC_LANE 2048
+
+// a * b mod P of CRC32C in bit reflected form, x^0 is bit 31
+uint32_t crc_mulmod(uint32_t a, uint32_t b) {
+	uint32_t p = 0;
+	for (uint32_t m = 1u << 31; m; m >>= 1) {
+		if (a & m) p ^= b;
+		b = b & 1 ? (b >> 1) ^ 0x82f63b78 : b >> 1;
+	}
+	return p;
+}
+
+// x^n mod P, reflected
+uint32_t crc_xpow(uint64_t n) {
+	uint32_t r = 1u << 31, b = 1u << 30;
+	for (; n; n >>= 1, b = crc_mulmod (b, b))
+		if (n & 1) r = crc_mulmod (r, b);
+	return r;
+}
+
+void crc_init(void) {
+	for (uint32_t n = 0; n < 256; n++) {
+		uint32_t c = n;
+		for (int k = 0; k < 8; k++) c = c & 1 ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+		crc_lut[0][n] = c;
+	}
+	for (uint32_t n = 0; n < 256; n++)
+		for (int t = 1; t < 8; t++)
+			crc_lut[t][n] = (crc_lut[t-1][n] >> 8) ^ crc_lut[0][crc_lut[t-1][n] & 0xff];
+	// crc shifted over n bytes is crc32 of its carry-less product with x^(8n-33)
+	crc_k[0] = crc_xpow (8 * 2 * CRC_LANE - 33);
+	crc_k[1] = crc_xpow (8 * CRC_LANE - 33);
+#ifdef __x86_64__
+	crc_hw = __builtin_cpu_supports ("sse4.2");
+	crc_fold = crc_hw && __builtin_cpu_supports ("pclmul");
+#endif
+}
+
+#ifdef __x86_64__
+__attribute__((target("sse4.2")))
+uint32_t crc32c_hw(uint32_t c, const uint8_t* d, size_t n) {
+	uint64_t x = c;
+	for (; n >= 8; n -= 8, d += 8) {
+		uint64_t w;
+		memcpy (&w, d, 8);
+		x = _mm_crc32_u64 (x, w);
+	}
+	c = x;
+	while (n--) c = _mm_crc32_u8 (c, *d++);
+	return c;
+}
+
+/*
+ * Long spans by blocks of 3 lanes whose crc32 streams run side by side,
+ * as one waits 3 cycles on its last result. Lane crcs are folded into one
+ * with pclmul: crc of a | b | e is a shifted over 2 lanes, b over 1, and e.
+ */
+__attribute__((target("sse4.2,pclmul")))
+uint32_t crc32c_fold(uint32_t c, const uint8_t* d, size_t n) {
+	for (; n >= 3 * CRC_LANE; n -= 3 * CRC_LANE, d += 3 * CRC_LANE) {
+		uint64_t a = c, b = 0, e = 0;
+		for (size_t j = 0; j < CRC_LANE; j += 8) {
+			uint64_t w[3];
+			memcpy (&w[0], d + j, 8);
+			memcpy (&w[1], d + CRC_LANE + j, 8);
+			memcpy (&w[2], d + 2 * CRC_LANE + j, 8);
+			a = _mm_crc32_u64 (a, w[0]);
+			b = _mm_crc32_u64 (b, w[1]);
+			e = _mm_crc32_u64 (e, w[2]);
+		}
+		__m128i p = _mm_xor_si128 (
+			_mm_clmulepi64_si128 (_mm_cvtsi32_si128 (a), _mm_cvtsi32_si128 (crc_k[0]), 0),
+			_mm_clmulepi64_si128 (_mm_cvtsi32_si128 (b), _mm_cvtsi32_si128 (crc_k[1]), 0));
+		c = _mm_crc32_u64 (0, _mm_cvtsi128_si64 (p)) ^ e;
+	}
+	return crc32c_hw (c, d, n);
+}
+#endif
+
+// CRC32C of n bytes at d
+uint32_t crc32c(const uint8_t* d, size_t n) {
+	uint32_t c = ~0u;
+	if (crc_lut[0][1] == 0) crc_init ();
+#ifdef __x86_64__
+	if (crc_fold && n >= 3 * CRC_LANE) return ~crc32c_fold (c, d, n);
+	if (crc_hw) return ~crc32c_hw (c, d, n);
+#endif
+	for (; n >= 8 && HOST_ENDIAN == '<'; n -= 8, d += 8) {
+		uint64_t x;
+		memcpy (&x, d, 8);
+		x ^= c;
+		c = crc_lut[7][x & 0xff] ^ crc_lut[6][(x >> 8) & 0xff] ^ crc_lut[5][(x >> 16) & 0xff] ^ crc_lut[4][(x >> 24) & 0xff] ^
+			crc_lut[3][(x >> 32) & 0xff] ^ crc_lut[2][(x >> 40) & 0xff] ^ crc_lut[1][(x >> 48) & 0xff] ^ crc_lut[0][x >> 56];
+	}
+	while (n--) c = (c >> 8) ^ crc_lut[0][(c ^ *d++) & 0xff];
+	return ~c;
+}
+
+
+// longest array held whole in memory, longer ones are streamed in chunks of it
+#define ARR_MAX 65535
+#define TZ_MAX (14 * 3600) // widest UTC offset of timestamp print, +14:00
+
+struct Fmt {
+	char endian;
+	char format;
+	char* print;
+	uint64_t count;
+	void* data;
+	uint32_t size;
+	char* name;
+	uint8_t bits;  // width of t T element
+	uint32_t bit;  // offset of t T field in its run of bit fields
+	uint32_t span; // bytes before C field it covers, 0 for whole record
+	struct Dict* dict; // names of values printed instead of them
+	char ts;           // timestamp print unit S M U N, 0 for numbers
+	char shortest;     // f d printed shortest that reads back (-p r)
+	int32_t tz;        // timestamp print offset east of UTC in seconds
+	struct Fmt* next;
+};
+
+
+__extension__ typedef unsigned __int128 u128;
+
+// splitmix64 finalizer, mixes all bits of z into all bits of result
+uint64_t mix64(uint64_t z) {
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+/*
+ * Names of integer values loaded from a dictionary file. Values spanning
+ * few enough numbers are looked up in a dense table (range entries from
+ * min, one more NULL entry past them), others by a perfect hash: bucket of
+ * value picks displacement which gives its own slot of keys and names.
+ */
+struct Dict {
+	char* path;
+	char* text;          // file contents, names point into it
+	int64_t min;
+	uint64_t range;      // dense table size, 0 when hashed
+	uint64_t mask;       // hash slots - 1
+	uint64_t nb;         // hash buckets
+	uint32_t* disp;
+	int64_t* keys;
+	const char** names;
+};
+
+// slot of value v in hashed dict with displacement d
+uint64_t dict_slot(uint64_t v, uint64_t d, uint64_t mask) {
+	return mix64 (v ^ (d + 1) * 0x9e3779b97f4a7c15ull) & mask;
+}
+
+// name of value v, NULL when dict has none
+const char* dict_get(const struct Dict* t, int64_t v) {
+	if (t->range) {
+		uint64_t k = (uint64_t)v - (uint64_t)t->min;
+		return t->names[k < t->range ? k : t->range];
+	}
+	uint64_t b = (u128)mix64 (v) * t->nb >> 64;
+	uint64_t k = dict_slot (v, t->disp[b], t->mask);
+	return t->keys[k] == v ? t->names[k] : NULL;
+}
+
+void dict_free(struct Dict* t) {
+	if (t == NULL) return;
+	free (t->path);
+	free (t->text);
+	free (t->disp);
+	free (t->keys);
+	free (t->names);
+	free (t);
+}
+
+int u64_cmp(const void* a, const void* b) {
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+// buckets of (bucket, size) pairs largest first
+int dict_bucket_cmp(const void* a, const void* b) {
+	uint64_t x = ((const uint64_t*)a)[1], y = ((const uint64_t*)b)[1];
+	return (x < y) - (x > y);
+}
+
+/*
+ * Build perfect hash of n values v with names nm into t: buckets are placed
+ * largest first, each with the first displacement that puts all its values
+ * into free slots. Returns 0, -1 on allocation error or -2 when a bucket
+ * finds no place.
+ */
+int dict_hash(struct Dict* t, const int64_t* v, const char** nm, uint64_t n) {
+	uint64_t m = 2;
+	while (m < n * 2) m *= 2;
+	t->mask = m - 1;
+	t->nb = n / 4 + 1;
+	t->disp = calloc (t->nb, sizeof(uint32_t));
+	t->keys = calloc (m, sizeof(int64_t));
+	t->names = calloc (m, sizeof(char*));
+	uint64_t* bk = malloc (t->nb * 2 * sizeof(uint64_t)); // bucket, its size
+	uint64_t* st = calloc (t->nb + 1, sizeof(uint64_t));  // first value of bucket
+	uint64_t* ord = malloc (n * sizeof(uint64_t));        // values by bucket
+	uint64_t* at = malloc (n * sizeof(uint64_t));
+	int err = !t->disp || !t->keys || !t->names || !bk || !st || !ord || !at ? -1 : 0;
+	for (uint64_t j = 0; !err && j < n; j++) st[((u128)mix64 (v[j]) * t->nb >> 64) + 1]++;
+	for (uint64_t b = 0; !err && b < t->nb; b++) {
+		st[b + 1] += st[b];
+		bk[b * 2] = b;
+		bk[b * 2 + 1] = st[b + 1] - st[b];
+		at[b] = st[b]; // fill position
+	}
+	for (uint64_t j = 0; !err && j < n; j++) ord[at[(u128)mix64 (v[j]) * t->nb >> 64]++] = j;
+	if (!err) qsort (bk, t->nb, 2 * sizeof(uint64_t), dict_bucket_cmp);
+	for (uint64_t q = 0; !err && q < t->nb && bk[q * 2 + 1]; q++) {
+		uint64_t b = bk[q * 2], c = bk[q * 2 + 1];
+		const uint64_t* o = ord + st[b];
+		uint32_t d = 0;
+		for (;; d++) {
+			uint64_t j = 0;
+			for (; j < c; j++) {
+				at[j] = dict_slot (v[o[j]], d, t->mask);
+				if (t->names[at[j]]) break;
+				t->names[at[j]] = nm[o[j]]; // taken for now, also by own values
+			}
+			if (j == c) break;
+			while (j--) t->names[at[j]] = NULL;
+			if (d == UINT32_MAX) {
+				err = -2;
+				break;
+			}
+		}
+		t->disp[b] = d;
+		for (uint64_t j = 0; !err && j < c; j++) t->keys[at[j]] = v[o[j]];
+	}
+	free (bk);
+	free (st);
+	free (ord);
+	free (at);
+	return err;
+}
+
+/*
+ * Load dictionary file path of "VALUE NAME" (or "VALUE=NAME") lines, #
+ * comment lines and " #" comments after names, into *out. Returns 0, -1 when file could not be read or on
+ * allocation error, -2 on invalid line (*line gets its number), -3 when a
+ * value is given twice, -4 when no perfect hash is found.
+ */
+int dict_load(const char* path, struct Dict** out, uint64_t* line) {
+	struct Dict* t = calloc (1, sizeof(struct Dict));
+	FILE* f = fopen (path, "rb");
+	size_t len = 0, r = 1;
+	if (t) t->path = strdup (path);
+	for (size_t cap = 0; t && t->path && f && r; len += r) {
+		if (len + 4096 > cap) {
+			cap = cap ? cap * 2 : 65536;
+			char* x = realloc (t->text, cap);
+			if (x == NULL) break;
+			t->text = x;
+		}
+		r = fread (t->text + len, 1, cap - len - 1, f);
+	}
+	if (t == NULL || f == NULL || r || ferror (f)) {
+		if (f) fclose (f);
+		dict_free (t);
+		return -1;
+	}
+	t->text[len] = '\0';
+	fclose (f);
+
+	uint64_t n = 0, cap = 0, ln = 0;
+	int64_t* v = NULL;
+	const char** nm = NULL;
+	int err = 0;
+	for (char* s = t->text; s && *s && !err; ) {
+		char* e = strchr (s, '\n');
+		if (e) *e = '\0';
+		char* next = e ? e + 1 : NULL;
+		ln++;
+		while (*s == ' ' || *s == '\t') s++;
+		size_t l = strlen (s);
+		while (l && strchr (" \t\r", s[l - 1])) s[--l] = '\0';
+		if (*s && *s != '#') {
+			char* x = NULL;
+			int64_t val = *s == '-' ? strtoll (s, &x, 0) : (int64_t)strtoull (s, &x, 0);
+			if (x == s || !*x || !strchr (" \t=", *x)) err = -2;
+			while (!err && *x && strchr (" \t=", *x)) x++;
+			// blank and '#' start trailing comment, '#' inside name is kept
+			char* c = x;
+			while (!err && *c && !(*c == '#' && strchr (" \t", c[-1]))) c++;
+			while (c > x && strchr (" \t", c[-1])) c--;
+			if (!err) *c = '\0';
+			if (!err && *x == '\0') err = -2;
+			if (!err && n == cap) {
+				cap = cap ? cap * 2 : 64;
+				int64_t* a = realloc (v, cap * sizeof(int64_t));
+				if (a) v = a;
+				const char** b = realloc (nm, cap * sizeof(char*));
+				if (b) nm = b;
+				if (a == NULL || b == NULL) err = -1;
+			}
+			if (!err) {
+				v[n] = val;
+				nm[n++] = x;
+			}
+		}
+		s = next;
+	}
+
+	int64_t lo = n ? v[0] : 0, hi = lo;
+	for (uint64_t j = 0; j < n && !err; j++) {
+		if (v[j] < lo) lo = v[j];
+		if (v[j] > hi) hi = v[j];
+	}
+	uint64_t span = (uint64_t)hi - (uint64_t)lo;
+	if (!err && span < (n + 16) * 4 && span < (1 << 24)) {
+		t->min = lo;
+		t->range = span + 1;
+		t->names = calloc (t->range + 1, sizeof(char*));
+		if (t->names == NULL) err = -1;
+		for (uint64_t j = 0; !err && j < n; j++) {
+			const char** p = &t->names[v[j] - lo];
+			if (*p) err = -3;
+			*p = nm[j];
+		}
+	} else if (!err) {
+		// values repeated would never find place, check them first
+		int64_t* c = malloc (n * sizeof(int64_t));
+		if (c == NULL) err = -1;
+		if (c) {
+			memcpy (c, v, n * sizeof(int64_t));
+			qsort (c, n, sizeof(int64_t), u64_cmp);
+			for (uint64_t j = 1; !err && j < n; j++) if (c[j] == c[j - 1]) err = -3;
+		}
+		free (c);
+		if (!err) err = dict_hash (t, v, nm, n) == -2 ? -4 : 0;
+	}
+	free (v);
+	free (nm);
+	*line = ln;
+	if (err) {
+		dict_free (t);
+		return err;
+	}
+	*out = t;
+	return 0;
+}
+
+
+struct Fmt* new(struct Fmt** head) {
+	if (head == NULL) return NULL;
+	if (*head == NULL) {
+		*head = malloc (sizeof(struct Fmt));
+		if (*head == NULL) return NULL;
+		(*head)->endian = '@';
+		(*head)->format = 0;
+		(*head)->print = "";
+		(*head)->count = 1;
+		(*head)->data = NULL;
+		(*head)->size = 0;
+		(*head)->name = NULL;
+		(*head)->bits = 0;
+		(*head)->bit = 0;
+		(*head)->span = 0;
+		(*head)->dict = NULL;
+		(*head)->ts = 0;
+		(*head)->shortest = 0;
+		(*head)->tz = 0;
+		(*head)->next = NULL;
+		return *head;
+	} else {
+		for (struct Fmt* x = *head; x; x = x->next) {
+			if (x->next == NULL) {
+				return new (&(x->next));
+			}	
+		}
+		//somethting went wrong
+		return NULL;
+	}
+}
+
+void delete(struct Fmt** head) {
+	if (head == NULL) return;
+	for (struct Fmt* x = *head; x;) {
+		struct Fmt* y = x->next;
+		if (x->data)
+			free(x->data);
+		// dictionary shared by fields is freed with the last of them
+		for (struct Fmt* z = y; x->dict && z; z = z->next)
+			if (z->dict == x->dict) x->dict = NULL;
+		dict_free (x->dict);
+		memset (x, 0, sizeof(struct Fmt));
+		free (x);
+		x = y;
+	}
+	*head = NULL;
+}
+
+
+// size of single fmt element, 0 for variable size (s p)
+size_t fmt_size(char format) {
+	switch (format) {
+		case 'x':
+		case 'c':
+		case 'b':
+		case 'B': return 1;
+		case 'h':
+		case 'H': return 2;
+		case 'i':
+		case 'I':
+		case 'C':
+		case 'f': return 4;
+		case 'q':
+		case 'Q':
+		case 'd': return 8;
+	}
+	return 0;
+}
+
+// s p v z fields have size known only from data
+int fmt_var(char format) {
+	return format == 's' || format == 'p' || format == 'v' || format == 'z';
+}
+
+// max bytes of single fmt element
+size_t fmt_max(char format) {
+	if (format == 's' || format == 'p') return 256;
+	if (format == 'v' || format == 'z') return 10;
+	return fmt_size (format);
+}
+
+/*
+ * Decode count LEB128 varints from n bytes of d into v, zigzag ones are
+ * turned back into signed. While 8 bytes are left the end of a varint is
+ * found from the continuation bits of a whole word and its 7-bit groups
+ * are squeezed together without a per byte loop, longer varints and the
+ * tail go byte by byte. Returns consumed bytes, 0 when data ends early,
+ * (size_t)-1 when varint is longer than 10 bytes.
+ */
+size_t varint_get(uint64_t* v, uint32_t count, const uint8_t* d, size_t n, int zigzag) {
+	size_t o = 0;
+	for (uint32_t k = 0; k < count; k++) {
+		uint64_t x = 0, m = 0;
+		if (n - o >= 8) {
+			memcpy (&x, d + o, 8);
+			if (HOST_ENDIAN == '>') x = __builtin_bswap64 (x);
+			m = ~x & 0x8080808080808080ull;
+		}
+		if (m) {
+			unsigned l = __builtin_ctzll (m) / 8 + 1;
+			if (l < 8) x &= (1ull << (l * 8)) - 1;
+#ifdef __BMI2__
+			x = _pext_u64 (x, 0x7f7f7f7f7f7f7f7full);
+#else
+			x &= 0x7f7f7f7f7f7f7f7full;
+			x = ((x & 0x7f007f007f007f00ull) >> 1) | (x & 0x007f007f007f007full);
+			x = ((x & 0x3fff00003fff0000ull) >> 2) | (x & 0x00003fff00003fffull);
+			x = ((x & 0x0fffffff00000000ull) >> 4) | (x & 0x000000000fffffffull);
+#endif
+			o += l;
+		} else {
+			x = 0;
+			for (unsigned s = 0; ; s += 7) {
+				if (s > 63) return (size_t)-1;
+				if (o >= n) return 0;
+				uint8_t b = d[o++];
+				x |= (uint64_t)(b & 0x7f) << s;
+				if (!(b & 0x80)) break;
+			}
+		}
+		v[k] = zigzag ? (x >> 1) ^ -(x & 1) : x;
+	}
+	return o;
+}
+
+// encode x as LEB128 into d (10 bytes max), zigzag first for signed. Returns length
+size_t varint_put(uint8_t* d, uint64_t x, int zigzag) {
+	size_t l = 0;
+	if (zigzag) x = (x << 1) ^ (uint64_t)((int64_t)x >> 63);
+	for (; x >= 0x80; x >>= 7) d[l++] = (x & 0x7f) | 0x80;
+	d[l++] = x;
+	return l;
+}
+
+// bytes of count varints at d, 0 when n bytes are not enough, (size_t)-1 when too long
+size_t varint_skip(const uint8_t* d, size_t n, uint32_t count) {
+	size_t o = 0;
+	for (uint32_t k = 0; k < count; k++) {
+		const uint8_t* e = d + o;
+		size_t m = n - o < 10 ? n - o : 10;
+		size_t l = 0;
+		while (l < m && (e[l] & 0x80)) l++;
+		if (l == m) return m == 10 ? (size_t)-1 : 0;
+		o += l + 1;
+	}
+	return o;
+}
+
+
+/*
+ * Bytes field i adds to a record, 0 for s and p. Consecutive bit fields
+ * (t T) share bytes, every byte of such run is counted for the field whose
+ * bits start it, so a field that starts inside a byte begins one byte
+ * before the sum of fmt_bytes of preceding fields.
+ */
+size_t fmt_bytes(struct Fmt* i) {
+	if (i->bits) return (i->bit + (size_t)i->bits * i->count + 7) / 8 - (i->bit + 7) / 8;
+	return fmt_size (i->format) * i->count;
+}
+
+// bytes of bit field run starting with field i
+size_t bits_run(struct Fmt* i) {
+	size_t n = 0;
+	for (; i && i->bits; i = i->next) n += fmt_bytes (i);
+	return n;
+}
+
+/*
+ * Get w bits at bit offset bit of d, msb selects MSB-first bit order.
+ * Loads whole 64-bit words, at most 9 bytes from bit/8 are touched,
+ * bytes at or past end are read as 0.
+ */
+uint64_t bits_get(const uint8_t* d, uint64_t bit, uint8_t w, int msb, const uint8_t* end) {
+	const uint8_t* p = d + bit / 8;
+	unsigned sh = bit % 8;
+	uint8_t t[9] = { 0 };
+	uint64_t x;
+	if (p + 9 <= end) {
+		memcpy (t, p, 9);
+	} else {
+		memcpy (t, p, end - p);
+	}
+	memcpy (&x, t, 8);
+	if (msb) {
+		if (HOST_ENDIAN == '<') x = __builtin_bswap64 (x);
+		x <<= sh;
+		if (sh + w > 64) x |= (uint64_t)t[8] >> (8 - sh);
+		return x >> (64 - w);
+	}
+	if (HOST_ENDIAN == '>') x = __builtin_bswap64 (x);
+	x >>= sh;
+	if (sh + w > 64) x |= (uint64_t)t[8] << (64 - sh);
+	return w == 64 ? x : x & ((1ull << w) - 1);
+}
+
+// set w bits at bit offset bit of d to v, d must have 9 bytes from bit/8
+void bits_put(uint8_t* d, uint64_t bit, uint8_t w, int msb, uint64_t v) {
+	uint8_t* p = d + bit / 8;
+	unsigned sh = bit % 8;
+	uint64_t m = w == 64 ? ~0ull : (1ull << w) - 1;
+	uint64_t x;
+	v &= m;
+	memcpy (&x, p, 8);
+	if (msb) {
+		if (HOST_ENDIAN == '<') x = __builtin_bswap64 (x);
+		if (sh + w <= 64) {
+			x = (x & ~(m << (64 - sh - w))) | (v << (64 - sh - w));
+		} else {
+			unsigned r = sh + w - 64; // bits going to p[8]
+			x = (x & ~(~0ull >> sh)) | (v >> r);
+			p[8] = (p[8] & (0xff >> r)) | (uint8_t)(v << (8 - r));
+		}
+		if (HOST_ENDIAN == '<') x = __builtin_bswap64 (x);
+	} else {
+		if (HOST_ENDIAN == '>') x = __builtin_bswap64 (x);
+		if (sh + w <= 64) {
+			x = (x & ~(m << sh)) | (v << sh);
+		} else {
+			unsigned r = sh + w - 64;
+			x = (x & ((1ull << sh) - 1)) | (v << sh);
+			p[8] = (p[8] & (0xff << r)) | (uint8_t)(v >> (64 - sh));
+		}
+		if (HOST_ENDIAN == '>') x = __builtin_bswap64 (x);
+	}
+	memcpy (p, &x, 8);
+}
+
+/*
+ * Extract all values of bit field i into v, d points where the field is
+ * in record (sum of fmt_bytes of preceding fields). t values are sign extended.
+ */
+void bits_load(uint64_t* v, struct Fmt* i, const uint8_t* d, const uint8_t* end) {
+	int msb = (i->endian == '@' ? HOST_ENDIAN : i->endian) == '>';
+	uint8_t w = i->bits;
+	if (i->bit % 8) d--;
+	for (uint32_t k = 0, b = i->bit % 8; k < i->count; k++, b += w) {
+		v[k] = bits_get (d, b, w, msb, end);
+		if (i->format == 't' && w < 64) v[k] = (uint64_t)((int64_t)(v[k] << (64 - w)) >> (64 - w));
+	}
+}
+
+// C type of single fmt element as used by generated code
+const char* fmt_ctype(char format) {
+	switch (format) {
+		case 'c': return "char";
+		case 'b': return "int8_t";
+		case 'B': return "uint8_t";
+		case 'h': return "int16_t";
+		case 'H': return "uint16_t";
+		case 'i': return "int32_t";
+		case 'I': return "uint32_t";
+		case 'q': return "int64_t";
+		case 'Q': return "uint64_t";
+		case 'f': return "float";
+		case 'd': return "double";
+		case 's':
+		case 'p': return "char";
+	}
+	return "uint8_t";
+}
+
+
+// print s as C string literal
+void gen_str(FILE* out, const char* s) {
+	fputc ('"', out);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') fprintf (out, "\\%c", *s);
+		else if (*s >= ' ' && *s <= '~') fputc (*s, out);
+		else fprintf (out, "\\%03o", (uint8_t)*s);
+	}
+	fputc ('"', out);
+}
+
+// C identifier for struct member, taken from name or "f<idx>" when unnamed
+char* gen_ident(struct Fmt* i, uint32_t idx) {
+	char* id = malloc ((i->name ? strlen (i->name) : 0) + 16);
+	if (id == NULL) return NULL;
+	if (i->name == NULL || *i->name == 0) {
+		sprintf (id, "f%u", idx);
+		return id;
+	}
+	char* t = id;
+	if (*i->name >= '0' && *i->name <= '9') *t++ = '_';
+	for (char* s = i->name; *s; s++)
+		*t++ = (*s >= 'a' && *s <= 'z') || (*s >= 'A' && *s <= 'Z') || (*s >= '0' && *s <= '9') ? *s : '_';
+	*t = 0;
+	return id;
+}
+
+// swap macro used by generated code, NULL when no swap is needed
+const char* gen_swap(char e, size_t size) {
+	if (size == 1 || e == '@') return NULL;
+	if (e == '<') return size == 2 ? "SP_LE16" : size == 4 ? "SP_LE32" : "SP_LE64";
+	return size == 2 ? "SP_BE16" : size == 4 ? "SP_BE32" : "SP_BE64";
+}
+
+// cast matching the 64-bit print formats
+const char* gen_cast(char format) {
+	if (format == 'q') return "(long long)";
+	if (format == 'Q') return "(unsigned long long)";
+	return "";
+}
+
+/*
+ * Emit standalone C header with packed struct and pack/unpack/print
+ * functions specialized for fmts. Output of <prefix>_print() is the same
+ * as output of -r. Returns 0 on success.
+ */
+int gen(FILE* out, struct Fmt* fmts, const char* fmt, const char* prefix, uint8_t pad_byte, uint32_t max_name_size) {
+	uint32_t n = 0;
+	size_t fixed = 0, max = 0;
+	int var = 0;
+	for (struct Fmt* i = fmts; i; i = i->next) {
+		size_t s = fmt_size (i->format);
+		if (s == 0) {
+			var = 1;
+			max += (size_t)i->count * 256; // up to 255 chars + nul/len byte
+		} else {
+			fixed += s * i->count;
+			max += s * i->count;
+		}
+		n++;
+	}
+
+	// member identifiers, duplicates get field index appended
+	char** ids = calloc (n, sizeof(char*));
+	if (ids == NULL) return -1;
+	uint32_t idx = 0;
+	for (struct Fmt* i = fmts; i; i = i->next, idx++) {
+		if (i->format == 'x') continue;
+		ids[idx] = gen_ident (i, idx);
+		if (ids[idx] == NULL) goto fail;
+		for (uint32_t k = 0; k < idx; k++) {
+			if (ids[k] && strcmp (ids[k], ids[idx]) == 0) {
+				sprintf (ids[idx] + strlen (ids[idx]), "_%u", idx);
+				break;
+			}
+		}
+	}
+
+	char guard[64];
+	size_t gl = 0;
+	for (const char* s = prefix; *s && gl < sizeof(guard) - 3; s++)
+		guard[gl++] = *s >= 'a' && *s <= 'z' ? *s - 'a' + 'A' : *s;
+	guard[gl] = 0;
+
+	fprintf (out, "/* generated by sp -G %s ", prefix);
+	gen_str (out, fmt);
+	fprintf (out, ", do not edit */\n");
+	fprintf (out, "#ifndef %s_H\n#define %s_H\n\n", guard, guard);
+	fprintf (out, "#include <stdio.h>\n#include <stdint.h>\n#include <string.h>\n\n");
+	fprintf (out,
+		"#ifndef SP_LE16\n"
+		"#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__\n"
+		"#define SP_LE16(x) __builtin_bswap16(x)\n"
+		"#define SP_LE32(x) __builtin_bswap32(x)\n"
+		"#define SP_LE64(x) __builtin_bswap64(x)\n"
+		"#define SP_BE16(x) (x)\n"
+		"#define SP_BE32(x) (x)\n"
+		"#define SP_BE64(x) (x)\n"
+		"#else\n"
+		"#define SP_LE16(x) (x)\n"
+		"#define SP_LE32(x) (x)\n"
+		"#define SP_LE64(x) (x)\n"
+		"#define SP_BE16(x) __builtin_bswap16(x)\n"
+		"#define SP_BE32(x) __builtin_bswap32(x)\n"
+		"#define SP_BE64(x) __builtin_bswap64(x)\n"
+		"#endif\n"
+		"#endif\n\n");
+	if (!var) fprintf (out, "#define %s_SIZE %zu\n", guard, fixed);
+	fprintf (out, "#define %s_MAX_SIZE %zu\n\n", guard, max);
+
+	// struct
+	fprintf (out, "struct %s {\n", prefix);
+	idx = 0;
+	for (struct Fmt* i = fmts; i; i = i->next, idx++) {
+		if (i->format == 'x') continue;
+		fprintf (out, "\t%s %s", fmt_ctype (i->format), ids[idx]);
+		if (i->count > 1 || i->format == 'c') fprintf (out, "[%zu]", (size_t)i->count);
+		if (i->format == 's' || i->format == 'p') fprintf (out, "[256]");
+		fprintf (out, ";\n");
+	}
+	fprintf (out, "} __attribute__((packed));\n\n");
+
+	// unpack
+	fprintf (out,
+		"/* decode one record from buf, returns consumed bytes or 0 when buf is too short */\n"
+		"static inline size_t %s_unpack (struct %s* r, const void* buf, size_t len) {\n"
+		"\tconst uint8_t* p = buf;\n"
+		"\tconst uint8_t* e = p + len;\n"
+		"\tuint16_t u16; uint32_t u32; uint64_t u64;\n"
+		"\t(void)r; (void)e; (void)u16; (void)u32; (void)u64;\n", prefix, prefix);
+	if (!var) fprintf (out, "\tif (len < %s_SIZE) return 0;\n", guard);
+	idx = 0;
+	for (struct Fmt* i = fmts, *prev = NULL; i; prev = i, i = i->next, idx++) {
+		size_t s = fmt_size (i->format);
+		const char* sw = gen_swap (i->endian, s);
+		const char* m = ids[idx];
+		// one length check for each run of fixed size fields
+		if (var && s && (prev == NULL || fmt_size (prev->format) == 0)) {
+			size_t run = 0;
+			for (struct Fmt* j = i; j && fmt_size (j->format); j = j->next)
+				run += fmt_size (j->format) * j->count;
+			fprintf (out, "\tif ((size_t)(e - p) < %zu) return 0;\n", run);
+		}
+		if (i->format == 'x') {
+			fprintf (out, "\tp += %zu;\n", (size_t)i->count);
+		} else if (i->format == 's') {
+			fprintf (out, "\tfor (size_t k = 0; k < %zu; k++) {\n", (size_t)i->count);
+			fprintf (out, "\t\tconst uint8_t* z = memchr (p, 0, (size_t)(e - p) < 256 ? (size_t)(e - p) : 256);\n");
+			fprintf (out, "\t\tif (z == NULL) return 0;\n");
+			fprintf (out, "\t\tmemcpy (r->%s%s, p, z - p + 1);\n", m, i->count > 1 ? "[k]" : "");
+			fprintf (out, "\t\tp = z + 1;\n\t}\n");
+		} else if (i->format == 'p') {
+			fprintf (out, "\tfor (size_t k = 0; k < %zu; k++) {\n", (size_t)i->count);
+			fprintf (out, "\t\tif (p == e) return 0;\n");
+			fprintf (out, "\t\tsize_t l = *p++;\n");
+			fprintf (out, "\t\tif ((size_t)(e - p) < l) return 0;\n");
+			fprintf (out, "\t\tmemcpy (r->%s%s, p, l);\n", m, i->count > 1 ? "[k]" : "");
+			fprintf (out, "\t\tr->%s%s[l] = 0;\n", m, i->count > 1 ? "[k]" : "");
+			fprintf (out, "\t\tp += l;\n\t}\n");
+		} else if (sw == NULL) {
+			fprintf (out, "\tmemcpy (%sr->%s, p, %zu); p += %zu;\n", i->count > 1 || i->format == 'c' ? "" : "&", m, s * i->count, s * i->count);
+		} else if (i->count == 1) {
+			fprintf (out, "\tmemcpy (&u%zu, p, %zu); u%zu = %s (u%zu); memcpy (&r->%s, &u%zu, %zu); p += %zu;\n",
+				s * 8, s, s * 8, sw, s * 8, m, s * 8, s, s);
+		} else {
+			fprintf (out, "\tfor (size_t k = 0; k < %zu; k++, p += %zu) {\n", (size_t)i->count, s);
+			fprintf (out, "\t\tmemcpy (&u%zu, p, %zu); u%zu = %s (u%zu); memcpy (&r->%s[k], &u%zu, %zu);\n",
+				s * 8, s, s * 8, sw, s * 8, m, s * 8, s);
+			fprintf (out, "\t}\n");
+		}
+	}
+	fprintf (out, "\treturn p - (const uint8_t*)buf;\n}\n\n");
+
+	// pack
+	fprintf (out,
+		"/* encode one record into buf of at least %s_MAX_SIZE bytes, returns written bytes */\n"
+		"static inline size_t %s_pack (const struct %s* r, void* buf) {\n"
+		"\tuint8_t* p = buf;\n"
+		"\tuint16_t u16; uint32_t u32; uint64_t u64;\n"
+		"\t(void)r; (void)u16; (void)u32; (void)u64;\n", guard, prefix, prefix);
+	idx = 0;
+	for (struct Fmt* i = fmts; i; i = i->next, idx++) {
+		size_t s = fmt_size (i->format);
+		const char* sw = gen_swap (i->endian, s);
+		const char* m = ids[idx];
+		if (i->format == 'x') {
+			fprintf (out, "\tmemset (p, 0x%.2x, %zu); p += %zu;\n", pad_byte, (size_t)i->count, (size_t)i->count);
+		} else if (i->format == 's') {
+			fprintf (out, "\tfor (size_t k = 0; k < %zu; k++) {\n", (size_t)i->count);
+			fprintf (out, "\t\tsize_t l = strnlen (r->%s%s, 255);\n", m, i->count > 1 ? "[k]" : "");
+			fprintf (out, "\t\tmemcpy (p, r->%s%s, l);\n", m, i->count > 1 ? "[k]" : "");
+			fprintf (out, "\t\tp[l] = 0;\n\t\tp += l + 1;\n\t}\n");
+		} else if (i->format == 'p') {
+			fprintf (out, "\tfor (size_t k = 0; k < %zu; k++) {\n", (size_t)i->count);
+			fprintf (out, "\t\tsize_t l = strnlen (r->%s%s, 255);\n", m, i->count > 1 ? "[k]" : "");
+			fprintf (out, "\t\t*p++ = l;\n");
+			fprintf (out, "\t\tmemcpy (p, r->%s%s, l);\n", m, i->count > 1 ? "[k]" : "");
+			fprintf (out, "\t\tp += l;\n\t}\n");
+		} else if (sw == NULL) {
+			fprintf (out, "\tmemcpy (p, %sr->%s, %zu); p += %zu;\n", i->count > 1 || i->format == 'c' ? "" : "&", m, s * i->count, s * i->count);
+		} else if (i->count == 1) {
+			fprintf (out, "\tmemcpy (&u%zu, &r->%s, %zu); u%zu = %s (u%zu); memcpy (p, &u%zu, %zu); p += %zu;\n",
+				s * 8, m, s, s * 8, sw, s * 8, s * 8, s, s);
+		} else {
+			fprintf (out, "\tfor (size_t k = 0; k < %zu; k++, p += %zu) {\n", (size_t)i->count, s);
+			fprintf (out, "\t\tmemcpy (&u%zu, &r->%s[k], %zu); u%zu = %s (u%zu); memcpy (p, &u%zu, %zu);\n",
+				s * 8, m, s, s * 8, sw, s * 8, s * 8, s);
+			fprintf (out, "\t}\n");
+		}
+	}
+	fprintf (out, "\treturn p - (uint8_t*)buf;\n}\n\n");
+
+	// print, same output as -r
+	fprintf (out,
+		"/* print record the same way as sp -r does */\n"
+		"static inline void %s_print (FILE* out, const struct %s* r) {\n", prefix, prefix);
+	idx = 0;
+	for (struct Fmt* i = fmts; i; i = i->next, idx++) {
+		if (i->format == 'x') continue;
+		const char* m = ids[idx];
+		if (i->name && strlen (i->name)) {
+			char* t = malloc (strlen (i->name) + max_name_size + 3);
+			if (t == NULL) goto fail;
+			sprintf (t, "%-*s: ", (int)max_name_size, i->name);
+			fprintf (out, "\tfputs (");
+			gen_str (out, t);
+			fprintf (out, ", out);\n");
+			free (t);
+		}
+		if (i->count == 1 && i->format != 'c') {
+			fprintf (out, "\tfprintf (out, ");
+			gen_str (out, i->print);
+			fprintf (out, ", %sr->%s);\n", gen_cast (i->format), m);
+		} else {
+			fprintf (out, "\tfor (size_t k = 0; k < %zu; k++) {\n", (size_t)i->count);
+			if (i->format != 'c') fprintf (out, "\t\tif (k) fputs (\", \", out);\n");
+			fprintf (out, "\t\tfprintf (out, ");
+			gen_str (out, i->print);
+			fprintf (out, ", %sr->%s[k]);\n\t}\n", gen_cast (i->format), m);
+		}
+		fprintf (out, "\tfputc ('\\n', out);\n");
+	}
+	fprintf (out, "}\n\n#endif\n");
+
+	for (uint32_t k = 0; k < n; k++) free (ids[k]);
+	free (ids);
+	return 0;
+
+fail:
+	for (uint32_t k = 0; k < n; k++) free (ids[k]);
+	free (ids);
+	return -1;
+}
+
+// position inside a stream of records while walking it byte by byte
+struct Walk {
+	struct Fmt* head;
+	struct Fmt* f;   // current field
+	uint32_t k;      // current element of s p v z field
+	uint64_t left;   // bytes left in current fixed field or pascal string
+	uint8_t state;   // WALK_*
+};
+enum { WALK_FIELD, WALK_FIXED, WALK_CSTR, WALK_PLEN, WALK_PSTR, WALK_VARINT };
+
+/*
+ * Advance w over n bytes of d and set mark[j] for every byte that starts
+ * a field. Fixed size fields are skipped as a whole, only s and p fields
+ * need to look at data.
+ */
+void walk(struct Walk* w, const uint8_t* d, size_t n, uint8_t* mark) {
+	for (size_t j = 0; j < n; ) {
+		struct Fmt* f = w->f;
+		if (w->state == WALK_FIELD) {
+			w->k = 0;
+			w->left = fmt_bytes (f);
+			// bit field inside byte already started by previous one
+			if (f->bits && w->left == 0) {
+				w->f = f->next ? f->next : w->head;
+				continue;
+			}
+			mark[j] = 1;
+			w->state = !fmt_var (f->format) ? WALK_FIXED : f->format == 's' ? WALK_CSTR : f->format == 'p' ? WALK_PLEN : WALK_VARINT;
+		}
+		switch (w->state) {
+			case WALK_FIXED:
+			case WALK_PSTR: {
+				size_t t = w->left < n - j ? w->left : n - j;
+				j += t;
+				w->left -= t;
+				if (w->left) break;
+				if (w->state == WALK_PSTR && ++w->k < f->count) {
+					w->state = WALK_PLEN;
+					break;
+				}
+				w->f = f->next ? f->next : w->head;
+				w->state = WALK_FIELD;
+				break; }
+			case WALK_CSTR: {
+				const uint8_t* z = memchr (d + j, 0, n - j);
+				if (z == NULL) {
+					j = n;
+					break;
+				}
+				j = z - d + 1;
+				if (++w->k < f->count) break;
+				w->f = f->next ? f->next : w->head;
+				w->state = WALK_FIELD;
+				break; }
+			case WALK_VARINT:
+				// last byte of every varint has top bit clear
+				for (; j < n && w->k < f->count; j++)
+					w->k += !(d[j] & 0x80);
+				if (w->k < f->count) break;
+				w->f = f->next ? f->next : w->head;
+				w->state = WALK_FIELD;
+				break;
+			case WALK_PLEN:
+				w->left = d[j++];
+				w->state = WALK_PSTR;
+				if (w->left == 0) continue; // empty string, finish element
+				break;
+		}
+	}
+}
+
+// hexdump whole in to out, fields of fmts repeated till end of input are marked with '|'
+int xdump(FILE* in, FILE* out, struct Fmt* fmts) {
+	const size_t chunk = 1 << 20; // multiple of 16
+	uint8_t* d = malloc (chunk);
+	uint8_t* mark = malloc (chunk);
+	char* o = malloc (chunk / 16 * 96);
+	if (d == NULL || mark == NULL || o == NULL) {
+		free (d);
+		free (mark);
+		free (o);
+		return -1;
+	}
+	if (hex_lut[0] == 0) hex_init ();
+
+	struct Walk w = { fmts, fmts, 0, 0, WALK_FIELD };
+	uint64_t off = 0;
+	for (size_t n; (n = fread (d, 1, chunk, in)) > 0; ) {
+		memset (mark, 0, n);
+		walk (&w, d, n, mark);
+		char* p = o;
+		for (size_t j = 0; j < n; j += 16, off += 16)
+			p += hexline (p, off, d + j, n - j < 16 ? n - j : 16, mark + j);
+		fwrite (o, p - o, 1, out);
+	}
+	free (d);
+	free (mark);
+	free (o);
+	return 0;
+}
+
+
+// 64 bit significand of 10^-348, 10^-340, ..., 10^340 and its binary exponent
+const uint64_t pow10_f[87] = {
+	0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull, 0xcf42894a5dce35eaull,
+	0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull, 0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full,
+	0xbe5691ef416bd60cull, 0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+	0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull, 0xc21094364dfb5637ull,
+	0x9096ea6f3848984full, 0xd77485cb25823ac7ull, 0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull,
+	0xb23867fb2a35b28eull, 0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+	0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull, 0xb5b5ada8aaff80b8ull,
+	0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull, 0x964e858c91ba2655ull, 0xdff9772470297ebdull,
+	0xa6dfbd9fb8e5b88full, 0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+	0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull, 0xaa242499697392d3ull,
+	0xfd87b5f28300ca0eull, 0xbce5086492111aebull, 0x8cbccc096f5088ccull, 0xd1b71758e219652cull,
+	0x9c40000000000000ull, 0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+	0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull, 0x9f4f2726179a2245ull,
+	0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull, 0x83c7088e1aab65dbull, 0xc45d1df942711d9aull,
+	0x924d692ca61be758ull, 0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+	0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull, 0x952ab45cfa97a0b3ull,
+	0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull, 0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull,
+	0x88fcf317f22241e2ull, 0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+	0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull, 0x8bab8eefb6409c1aull,
+	0xd01fef10a657842cull, 0x9b10a4e5e9913129ull, 0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull,
+	0x80444b5e7aa7cf85ull, 0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+	0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull,
+};
+const int16_t pow10_e[87] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+	-901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+	-582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+	-263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+	56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+	375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+	694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+	1013, 1039, 1066,
+};
+
+// f * 2^e, what grisu works with
+struct Fp {
+	uint64_t f;
+	int e;
+};
+
+// a * b rounded to upper 64 bits
+struct Fp fp_mul(struct Fp a, struct Fp b) {
+	u128 p = (u128)a.f * b.f;
+	return (struct Fp){ (uint64_t)(p >> 64) + ((uint64_t)p >> 63), a.e + b.e + 64 };
+}
+
+struct Fp fp_norm(struct Fp a) {
+	int s = __builtin_clzll (a.f);
+	return (struct Fp){ a.f << s, a.e - s };
+}
+
+/*
+ * Grisu2 digit generation, digits of a number in (Wp - delta, Wp] closest
+ * to W are written to d, *k is adjusted by the dropped decimal places.
+ */
+int fp_digits(struct Fp W, struct Fp Wp, uint64_t delta, char* d, int* k) {
+	static const uint32_t p10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+	struct Fp one = { 1ull << -Wp.e, Wp.e };
+	uint64_t wp_w = Wp.f - W.f;
+	uint32_t p1 = Wp.f >> -one.e;
+	uint64_t p2 = Wp.f & (one.f - 1);
+	int n = 0, kappa = 1;
+	while (kappa < 10 && p1 >= p10[kappa]) kappa++;
+
+	uint64_t rest, ten_kappa;
+	for (;;) {
+		if (kappa > 0) {
+			uint32_t q = p1 / p10[kappa - 1];
+			p1 %= p10[kappa - 1];
+			if (q || n) d[n++] = '0' + q;
+			kappa--;
+			rest = ((uint64_t)p1 << -one.e) + p2;
+			if (rest > delta) continue;
+			ten_kappa = (uint64_t)p10[kappa] << -one.e;
+		} else {
+			p2 *= 10;
+			delta *= 10;
+			uint32_t q = p2 >> -one.e;
+			if (q || n) d[n++] = '0' + q;
+			p2 &= one.f - 1;
+			kappa--;
+			if (p2 >= delta) continue;
+			rest = p2;
+			ten_kappa = one.f;
+			wp_w *= -kappa < 10 ? p10[-kappa] : 0;
+		}
+		break;
+	}
+	*k += kappa;
+	// move last digit towards W while staying inside the interval
+	while (rest < wp_w && delta - rest >= ten_kappa &&
+			(rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+		d[n - 1]--;
+		rest += ten_kappa;
+	}
+	return n;
+}
+
+/*
+ * Write shortest digits that read back (strtod or strtof for single) into
+ * the same value, Grisu2 with boundaries of double or float precision and
+ * a printf fallback for the few values where it can not prove its digits
+ * shortest, as 1e23. Same layout as %g without its precision limit.
+ * Returns length.
+ */
+int fmt_short(char* o, double v, int single) {
+	char* b = o;
+	uint64_t bits;
+	memcpy (&bits, &v, 8);
+	if (bits >> 63) *o++ = '-';
+	if (v != v) return sprintf (b, "nan");
+	if (v - v != 0) return o - b + sprintf (o, "inf");
+	if (v == 0) {
+		*o++ = '0';
+		return o - b;
+	}
+
+	// significand and exponent in precision of the type
+	int mb = single ? 23 : 52;
+	struct Fp w;
+	if (single) {
+		float s = v;
+		uint32_t x;
+		memcpy (&x, &s, 4);
+		w.f = x & 0x7fffff;
+		w.e = (x >> 23) & 0xff;
+		w.e = w.e ? w.e - 150 : -149;
+		if (x & 0x7f800000) w.f |= 1ull << 23;
+	} else {
+		w.f = bits & 0xfffffffffffffull;
+		w.e = (bits >> 52) & 0x7ff;
+		w.e = w.e ? w.e - 1075 : -1074;
+		if (bits & 0x7ff0000000000000ull) w.f |= 1ull << 52;
+	}
+
+	// upper and lower boundary, lower is closer on power of two
+	struct Fp p = fp_norm ((struct Fp){ (w.f << 1) + 1, w.e - 1 });
+	struct Fp m = w.f == 1ull << mb ? (struct Fp){ (w.f << 2) - 1, w.e - 2 } : (struct Fp){ (w.f << 1) - 1, w.e - 1 };
+	m.f <<= m.e - p.e;
+	m.e = p.e;
+
+	// cached power bringing exponent into [-60, -32]
+	double dk = (-61 - p.e) * 0.30102999566398114 + 347;
+	int ki = (int)dk;
+	if (dk - ki > 0) ki++;
+	int idx = (ki >> 3) + 1;
+	int k = 348 - idx * 8;
+	struct Fp c = { pow10_f[idx], pow10_e[idx] };
+
+	struct Fp W = fp_mul (fp_norm (w), c);
+	struct Fp Wp = fp_mul (p, c);
+	struct Fp Wm = fp_mul (m, c);
+	Wm.f++;
+	Wp.f--;
+	char d[20], e[20];
+	int n = fp_digits (W, Wp, Wp.f - Wm.f, d, &k);
+
+	// Grisu2 digits are shortest when the interval widened by the rounding
+	// error of Wp and Wm has no fewer, else the shorter length is probed
+	// with printf and strtod or strtof reading back
+	int ke = 348 - idx * 8;
+	if (fp_digits (W, (struct Fp){ Wp.f + 2, Wp.e }, Wp.f - Wm.f + 4, e, &ke) < n) {
+		double a = bits >> 63 ? -v : v;
+		for (int l = 1; l < n; l++) {
+			char t[40];
+			sprintf (t, "%.*e", l - 1, a);
+			if (single ? strtof (t, NULL) != (float)a : strtod (t, NULL) != a) continue;
+			// "D.DDDe+X" into digits and exponent of last digit
+			n = 0;
+			for (char* q = t; *q != 'e'; q++)
+				if (*q != '.') d[n++] = *q;
+			k = atoi (strchr (t, 'e') + 1) - n + 1;
+			for (; n > 1 && d[n - 1] == '0'; n--) k++;
+			break;
+		}
+	}
+
+	// place decimal point, digits are d * 10^k
+	int kk = n + k;
+	if (k >= 0 && kk <= 17) {
+		memcpy (o, d, n);
+		o += n;
+		memset (o, '0', k);
+		o += k;
+	} else if (kk > 0 && kk <= 17) {
+		memcpy (o, d, kk);
+		o += kk;
+		*o++ = '.';
+		memcpy (o, d + kk, n - kk);
+		o += n - kk;
+	} else if (kk > -5 && kk <= 0) {
+		*o++ = '0';
+		*o++ = '.';
+		memset (o, '0', -kk);
+		o += -kk;
+		memcpy (o, d, n);
+		o += n;
+	} else {
+		*o++ = d[0];
+		if (n > 1) {
+			*o++ = '.';
+			memcpy (o, d + 1, n - 1);
+			o += n - 1;
+		}
+		o += sprintf (o, "e%c%02d", kk - 1 < 0 ? '-' : '+', abs (kk - 1));
+	}
+	return o - b;
+}
+
+/*
+ * Write v with prec (0..9) decimals the way %f does, exactly: value is
+ * m * 2^e, so v * 10^prec = m * 5^prec * 2^(e+prec) is rounded half to
+ * even in integers. Returns length, 0 when it does not fit (use printf).
+ */
+int fmt_fixed(char* o, double v, int prec) {
+	static const uint32_t p5[] = { 1, 5, 25, 125, 625, 3125, 15625, 78125, 390625, 1953125 };
+	static const uint32_t p10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+	uint64_t bits;
+	memcpy (&bits, &v, 8);
+	int e = (bits >> 52) & 0x7ff;
+	if (e == 0x7ff) return 0;
+	uint64_t m = bits & 0xfffffffffffffull;
+	if (e) m |= 1ull << 52;
+	e = (e ? e - 1075 : -1074) + prec;
+
+	u128 x = (u128)m * p5[prec];
+	uint64_t r;
+	if (e >= 0) {
+		if (e > 10 || (x << e) >> 64) return 0;
+		r = x << e;
+	} else if (-e >= 128) {
+		r = 0;
+	} else {
+		u128 q = x >> -e, rem = x - (q << -e), half = (u128)1 << (-e - 1);
+		if (q >> 64) return 0;
+		r = q;
+		if (rem > half || (rem == half && (r & 1))) r++;
+		if (r == 0 && q) return 0; // wrapped
+	}
+
+	char* b = o;
+	if (bits >> 63) *o++ = '-';
+	char t[24];
+	int n = 0;
+	for (uint64_t ip = r / p10[prec]; ip || n == 0; ip /= 10) t[n++] = '0' + ip % 10;
+	while (n) *o++ = t[--n];
+	if (prec) {
+		*o++ = '.';
+		uint32_t f = r % p10[prec];
+		for (int j = prec; j; j--, f /= 10) o[j - 1] = '0' + f % 10;
+		o += prec;
+	}
+	return o - b;
+}
+
+// integer value of element of field format f stored at d in host byte order
+int64_t int_at(char f, const uint8_t* d) {
+	int64_t v = 0;
+	switch (f) {
+		case 'b': v = *(int8_t*)d; break;
+		case 'B': v = *(uint8_t*)d; break;
+		case 'h': v = *(int16_t*)d; break;
+		case 'H': v = *(uint16_t*)d; break;
+		case 'i': v = *(int32_t*)d; break;
+		case 'I':
+		case 'C': v = *(uint32_t*)d; break;
+		default: memcpy (&v, d, 8); break;
+	}
+	return v;
+}
+
+// date text "YYYY-MM-DDT" of last day printed, per thread as -D prints from threads
+_Thread_local int64_t ts_day = INT64_MIN;
+_Thread_local char ts_date[32];
+_Thread_local int ts_dl;
+
+/*
+ * ISO-8601 text of timestamp v in unit u (S M U N: seconds, milli, micro,
+ * nanoseconds since epoch) of fmt fm at offset tz seconds east of UTC into
+ * o, returns its length, 0 for a time outside years 0000-9999 that is then
+ * printed as number. Date is made once per day from its number of days (civil
+ * from days), time of day and fraction by integer arithmetic.
+ */
+int ts_format(char* o, char u, int32_t tz, char fm, int64_t v) {
+	// unsigned 64-bit above INT64_MAX from int_at, and bounds before and after
+	// offset so s + tz does not overflow
+	const int64_t lo = -62167219200, hi = 253402300799;
+	if (v < 0 && strchr ("QTv", fm)) return 0;
+	int64_t q = u == 'S' ? 1 : u == 'M' ? 1000 : u == 'U' ? 1000000 : 1000000000;
+	int64_t s = v / q, f = v % q;
+	if (f < 0) {
+		s--;
+		f += q;
+	}
+	if (s < lo - TZ_MAX || s > hi + TZ_MAX) return 0;
+	s += tz;
+	if (s < lo || s > hi) return 0;
+	int64_t day = s / 86400, t = s % 86400;
+	if (t < 0) {
+		day--;
+		t += 86400;
+	}
+	if (day != ts_day) {
+		int64_t z = day + 719468;
+		int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+		int64_t doe = z - era * 146097;
+		int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+		int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+		int64_t mp = (5 * doy + 2) / 153;
+		int64_t m = mp < 10 ? mp + 3 : mp - 9;
+		ts_dl = sprintf (ts_date, "%04lld-%02d-%02dT", (long long)(yoe + era * 400 + (m <= 2)), (int)m, (int)(doy - (153 * mp + 2) / 5 + 1));
+		ts_day = day;
+	}
+	memcpy (o, ts_date, ts_dl);
+	char* p = o + ts_dl;
+	int x[3] = { t / 3600, t / 60 % 60, t % 60 };
+	for (int k = 0; k < 3; k++, p += 3) {
+		p[0] = '0' + x[k] / 10;
+		p[1] = '0' + x[k] % 10;
+		p[2] = ':';
+	}
+	p--;
+	if (q > 1) {
+		int n = q == 1000 ? 3 : q == 1000000 ? 6 : 9;
+		*p = '.';
+		for (int k = n; k; k--, f /= 10) p[k] = '0' + f % 10;
+		p += n + 1;
+	}
+	if (tz == 0) {
+		*p++ = 'Z';
+	} else {
+		int a = tz < 0 ? -tz / 60 : tz / 60;
+		p[0] = tz < 0 ? '-' : '+';
+		p[1] = '0' + a / 600;
+		p[2] = '0' + a / 60 % 10;
+		p[3] = ':';
+		p[4] = '0' + a % 60 / 10;
+		p[5] = '0' + a % 10;
+		p += 6;
+	}
+	return p - o;
+}
+
+// print "name: " of field i aligned to max_name_size, nothing when unnamed
+void print_name(FILE* out, struct Fmt* i, uint32_t max_name_size) {
+	size_t r;
+	if (i->name && strlen(i->name) && i->format != 'x'){
+		r = fprintf(out, "%s", i->name);
+		if (max_name_size > r)
+			for (uint32_t x = max_name_size - r; x; x--)
+				fprintf(out, " ");
+		fprintf (out, ": ");
+	}
+}
+
+// print all values of field i stored at d in host byte order
+void print_values(FILE* out, struct Fmt* i, uint8_t* d) {
+	size_t r;
+	char t[64];
+	int l;
+	for (uint64_t k = 0; k < i->count; k++) {
+		const char* s = i->dict ? dict_get (i->dict, int_at (i->format, d)) : NULL;
+		if (s) {
+			r = fputs (s, out);
+			d += fmt_size (i->format) ? fmt_size (i->format) : 8;
+		} else if (i->ts && (l = ts_format (t, i->ts, i->tz, i->format, int_at (i->format, d)))) {
+			r = fwrite (t, 1, l, out);
+			d += fmt_size (i->format) ? fmt_size (i->format) : 8;
+		} else switch (i->format){
+			case 'x':
+				break;
+			case 'c':
+				r = fprintf(out, i->print, *(char*)d);
+				d += sizeof(char);
+				break;
+			case 'b':
+				r = fprintf(out, i->print, *(int8_t*)d);
+				d += sizeof(int8_t);
+				break;
+			case 'B':
+				r = fprintf(out, i->print, *(uint8_t*)d);
+				d += sizeof(uint8_t);
+				break;
+			case 'h':
+				r = fprintf(out, i->print, *(int16_t*)d);
+				d += sizeof(int16_t);
+				break;
+			case 'H':
+				r = fprintf(out, i->print, *(uint16_t*)d);
+				d += sizeof(uint16_t);
+				break;
+			case 'i':
+				r = fprintf(out, i->print, *(int32_t*)d);
+				d += sizeof(int32_t);
+				break;
+			case 'I':
+			case 'C':
+				r = fprintf(out, i->print, *(uint32_t*)d);
+				d += sizeof(uint32_t);
+				break;
+			case 'q':
+			case 't':
+			case 'z':
+				r = fprintf(out, i->print, *(int64_t*)d);
+				d += sizeof(int64_t);
+				break;
+			case 'Q':
+			case 'T':
+			case 'v':
+				r = fprintf(out, i->print, *(uint64_t*)d);
+				d += sizeof(uint64_t);
+				break;
+			case 'f':
+			case 'd': {
+				// %f and shortest (%.9g %.17g) without printf
+				double v = i->format == 'f' ? *(float*)d : *(double*)d;
+				const char* p = i->print;
+				l = i->shortest ? fmt_short (t, v, i->format == 'f') : p[strlen (p) - 1] == 'f' ? fmt_fixed (t, v, 6) : 0;
+				if (l) r = fwrite (t, 1, l, out);
+				else r = fprintf(out, p, v);
+				d += fmt_size (i->format);
+				break; }
+			case 's':
+			case 'p':
+				r = fprintf(out, i->print, (char*)d);
+				d += r + 1;
+				break;
+
+		}
+		if (i->count > 1 && k < i->count-1 && i->format != 'x' && i->format != 'c')
+			fprintf (out, ", ");
+	}
+}
+
+
+// size of one record of fmts, 0 when there are variable size fields
+size_t rec_size(struct Fmt* fmts) {
+	size_t n = 0;
+	for (struct Fmt* i = fmts; i; i = i->next) {
+		if (fmt_var (i->format)) return 0;
+		n += fmt_bytes (i);
+	}
+	return n;
+}
+
+// map whole file f read only, empty file gives non NULL pointer and *len 0
+uint8_t* map_file(FILE* f, size_t* len) {
+	struct stat st;
+	if (fstat (fileno (f), &st) || !S_ISREG (st.st_mode)) return NULL;
+	*len = st.st_size;
+	if (*len == 0) return (uint8_t*)"";
+	void* m = mmap (NULL, *len, PROT_READ, MAP_PRIVATE, fileno (f), 0);
+	if (m == MAP_FAILED) return NULL;
+	madvise (m, *len, MADV_SEQUENTIAL);
+	return m;
+}
+
+void unmap_file(uint8_t* m, size_t len) {
+	if (m && len) munmap (m, len);
+}
+
+
+// range of records compared by one thread
+struct Cmp {
+	struct Fmt* fmts;
+	const uint8_t* a;
+	const uint8_t* b;
+	size_t rs;
+	uint64_t first;
+	uint64_t last;
+	uint32_t max_name_size;
+	char* buf;  // text output of the range
+	size_t len;
+	int err;
+};
+
+// print differing fields of record rec as "[rec] name: a -> b"
+void cmp_record(FILE* out, struct Cmp* c, uint64_t rec, uint8_t* x, uint8_t* y) {
+	const uint8_t* a = c->a + rec * c->rs;
+	const uint8_t* b = c->b + rec * c->rs;
+	const uint8_t* ae = a + c->rs;
+	const uint8_t* be = b + c->rs;
+	uint32_t idx = 0;
+	for (struct Fmt* i = c->fmts; i; i = i->next, idx++) {
+		size_t l = fmt_bytes (i);
+		int diff;
+		if (i->bits) {
+			bits_load ((uint64_t*)x, i, a, ae);
+			bits_load ((uint64_t*)y, i, b, be);
+			diff = memcmp (x, y, sizeof(uint64_t) * i->count);
+		} else {
+			diff = memcmp (a, b, l);
+		}
+		if (diff) {
+			fprintf (out, "[%llu] ", (unsigned long long)rec);
+			if (i->name && strlen (i->name)) print_name (out, i, c->max_name_size);
+			else fprintf (out, "f%u: ", idx);
+			if (i->format == 'x') {
+				for (size_t k = 0; k < l; k++) fprintf (out, "%.2x", a[k]);
+				fprintf (out, " -> ");
+				for (size_t k = 0; k < l; k++) fprintf (out, "%.2x", b[k]);
+			} else {
+				if (!i->bits) {
+					memcpy (x, a, l);
+					memcpy (y, b, l);
+					endian (i->endian, x, fmt_size (i->format), i->count);
+					endian (i->endian, y, fmt_size (i->format), i->count);
+				}
+				print_values (out, i, x);
+				fprintf (out, " -> ");
+				print_values (out, i, y);
+			}
+			fprintf (out, "\n");
+		}
+		a += l;
+		b += l;
+	}
+}
+
+#define CMP_BUF (16 << 20) // text held by one -D thread
+
+void* cmp_run(void* arg) {
+	struct Cmp* c = arg;
+	const uint64_t block = 65536 / c->rs + 1; // records compared at once
+	FILE* out = open_memstream (&c->buf, &c->len);
+	size_t xs = c->rs;
+	for (struct Fmt* i = c->fmts; i; i = i->next)
+		if (i->bits && xs < sizeof(uint64_t) * i->count) xs = sizeof(uint64_t) * i->count;
+	uint8_t* x = malloc (xs);
+	uint8_t* y = malloc (xs);
+	if (out == NULL || x == NULL || y == NULL) {
+		c->err = 1;
+		goto end;
+	}
+	for (uint64_t r = c->first; r < c->last; ) {
+		uint64_t n = c->last - r < block ? c->last - r : block;
+		// skip identical runs with a single memcmp
+		if (memcmp (c->a + r * c->rs, c->b + r * c->rs, n * c->rs) == 0) {
+			r += n;
+			continue;
+		}
+		for (; n && r < c->last; n--, r++) {
+			if (memcmp (c->a + r * c->rs, c->b + r * c->rs, c->rs) == 0) continue;
+			cmp_record (out, c, r, x, y);
+			// range ends early when its text grows over CMP_BUF
+			if (ftell (out) >= CMP_BUF) c->last = r + 1;
+		}
+	}
+end:
+	if (out) fclose (out);
+	free (x);
+	free (y);
+	return NULL;
+}
+
+/*
+ * Compare fixed size records of mapped files a and b, print differing fields.
+ * Work is split in chunks compared by up to jobs threads, output keeps
+ * record order. Returns 0 on success.
+ */
+int cmp_files(FILE* fa, FILE* fb, FILE* out, struct Fmt* fmts, size_t rs, uint32_t max_name_size,
+		uint32_t jobs, const char* na, const char* nb) {
+	size_t la = 0, lb = 0;
+	uint8_t* a = map_file (fa, &la);
+	uint8_t* b = map_file (fb, &lb);
+	if (a == NULL || b == NULL) {
+		unmap_file (a, la);
+		unmap_file (b, lb);
+		return -1;
+	}
+	uint64_t ra = la / rs, rb = lb / rs;
+	uint64_t recs = ra < rb ? ra : rb;
+	const uint64_t chunk = (64 << 20) / rs + 1; // records per thread and round
+	if (jobs < 1) jobs = 1;
+	struct Cmp* c = calloc (jobs, sizeof(struct Cmp));
+	pthread_t* t = calloc (jobs, sizeof(pthread_t));
+	int err = c == NULL || t == NULL;
+
+	for (uint64_t r = 0; r < recs && !err; ) {
+		uint32_t n = 0;
+		for (; n < jobs && r < recs; n++) {
+			c[n] = (struct Cmp){ fmts, a, b, rs, r, recs - r < chunk ? recs : r + chunk, max_name_size, NULL, 0, 0 };
+			r = c[n].last;
+			if (jobs > 1 && pthread_create (&t[n], NULL, cmp_run, &c[n])) {
+				c[n].err = 1;
+				n++;
+				break;
+			}
+			if (jobs == 1) cmp_run (&c[n]);
+		}
+		int cut = 0;
+		for (uint32_t k = 0; k < n; k++) {
+			if (jobs > 1 && !c[k].err) pthread_join (t[k], NULL);
+			if (c[k].err) err = 1;
+			if (c[k].buf && !cut) fwrite (c[k].buf, c[k].len, 1, out);
+			free (c[k].buf);
+			// range ended early, ranges after it are compared again from its end
+			if (!cut && c[k].last < (k + 1 < n ? c[k + 1].first : r)) {
+				cut = 1;
+				r = c[k].last;
+			}
+		}
+	}
+
+	if (!err && ra != rb)
+		fprintf (out, "only in %s: records %llu..%llu\n", ra > rb ? na : nb,
+			(unsigned long long)recs, (unsigned long long)(ra > rb ? ra : rb) - 1);
+
+	free (c);
+	free (t);
+	unmap_file (a, la);
+	unmap_file (b, lb);
+	return err ? -1 : 0;
+}
+
+
+// key field used by -S
+struct Key {
+	struct Fmt* f;
+	size_t off;  // offset of field in record
+};
+
+/*
+ * Write key of record r as bytes comparable with memcmp: every element is
+ * converted to host order, signed ints get sign bit flipped, floats are
+ * mapped to their total order and the result is stored big endian.
+ */
+void sort_key(uint8_t* k, const uint8_t* r, struct Key* keys, uint32_t nkeys) {
+	for (uint32_t j = 0; j < nkeys; j++) {
+		struct Fmt* f = keys[j].f;
+		size_t s = fmt_size (f->format);
+		const uint8_t* p = r + keys[j].off;
+		for (uint32_t e = 0; e < f->count; e++, p += s) {
+			uint8_t t[8];
+			uint64_t v = 0;
+			memcpy (t, p, s);
+			endian (f->endian, t, s, 1);
+			switch (s) {
+				case 1: v = t[0]; break;
+				case 2: { uint16_t x; memcpy (&x, t, 2); v = x; break; }
+				case 4: { uint32_t x; memcpy (&x, t, 4); v = x; break; }
+				case 8: memcpy (&v, t, 8); break;
+			}
+			uint64_t sign = 1ull << (s * 8 - 1);
+			if (strchr ("bhiq", f->format)) v ^= sign;
+			if (strchr ("fd", f->format)) v = v & sign ? ~v : v | sign;
+			for (size_t b = 0; b < s; b++) *k++ = v >> (8 * (s - 1 - b));
+		}
+	}
+}
+
+/*
+ * Stable LSD radix sort of n entries of es bytes, sorted by first kl bytes.
+ * Passes where all entries share the same byte are skipped. Returns e or
+ * tmp, whichever holds the result.
+ */
+uint8_t* radix_sort(uint8_t* e, uint8_t* tmp, size_t n, size_t es, size_t kl) {
+	size_t cnt[256];
+	if (n == 0) return e;
+	for (size_t b = kl; b--; ) {
+		memset (cnt, 0, sizeof(cnt));
+		for (size_t j = 0; j < n; j++) cnt[e[j * es + b]]++;
+		if (cnt[e[b]] == n) continue;
+		for (size_t j = 0, sum = 0; j < 256; j++) {
+			size_t c = cnt[j];
+			cnt[j] = sum;
+			sum += c;
+		}
+		for (size_t j = 0; j < n; j++)
+			memcpy (tmp + cnt[e[j * es + b]]++ * es, e + j * es, es);
+		uint8_t* x = e;
+		e = tmp;
+		tmp = x;
+	}
+	return e;
+}
+
+// sorted run of records in temporary file
+struct Run {
+	FILE* f;
+	uint8_t* buf;
+	size_t n;    // records in buf
+	size_t pos;  // current record in buf
+	uint8_t* key;
+};
+
+int run_next(struct Run* r, size_t rs, size_t cap, struct Key* keys, uint32_t nkeys) {
+	if (++r->pos >= r->n) {
+		r->n = fread (r->buf, rs, cap, r->f);
+		r->pos = 0;
+		if (r->n == 0) return 0;
+	}
+	sort_key (r->key, r->buf + r->pos * rs, keys, nkeys);
+	return 1;
+}
+
+// heap order of runs, equal keys keep input order
+int run_less(struct Run* a, struct Run* b, size_t kl) {
+	int c = memcmp (a->key, b->key, kl);
+	return c < 0 || (c == 0 && a < b);
+}
+
+void run_sift(struct Run** h, size_t n, size_t j, size_t kl) {
+	for (;;) {
+		size_t m = j, l = 2 * j + 1, r = 2 * j + 2;
+		if (l < n && run_less (h[l], h[m], kl)) m = l;
+		if (r < n && run_less (h[r], h[m], kl)) m = r;
+		if (m == j) return;
+		struct Run* t = h[j];
+		h[j] = h[m];
+		h[m] = t;
+		j = m;
+	}
+}
+
+/*
+ * Merge n sorted runs into o using up to mem bytes of read buffers.
+ * Run files are closed. Returns 0, -1 on allocation error.
+ */
+int merge_runs(struct Run* runs, size_t n, FILE* o, size_t rs, size_t mem, struct Key* keys, uint32_t nkeys, size_t kl, uint8_t uniq) {
+	size_t cap = mem / n / rs;
+	if (cap < 1) cap = 1;
+	struct Run** heap = malloc (n * sizeof(struct Run*));
+	uint8_t* last = malloc (kl);
+	int err = heap == NULL || last == NULL ? -1 : 0;
+	size_t h = 0;
+	for (size_t j = 0; j < n && !err; j++) {
+		struct Run* r = &runs[j];
+		r->buf = malloc (cap * rs);
+		r->key = malloc (kl);
+		if (r->buf == NULL || r->key == NULL) {
+			err = -1;
+			break;
+		}
+		rewind (r->f);
+		r->pos = 0;
+		r->n = fread (r->buf, rs, cap, r->f);
+		if (r->n == 0) continue;
+		sort_key (r->key, r->buf, keys, nkeys);
+		heap[h++] = r;
+	}
+	for (size_t j = h / 2; j-- > 0 && !err; ) run_sift (heap, h, j, kl);
+	int have_last = 0;
+	while (h && !err) {
+		struct Run* r = heap[0];
+		if (!uniq || !have_last || memcmp (last, r->key, kl)) {
+			memcpy (last, r->key, kl);
+			have_last = 1;
+			fwrite (r->buf + r->pos * rs, rs, 1, o);
+		}
+		if (!run_next (r, rs, cap, keys, nkeys)) heap[0] = heap[--h];
+		run_sift (heap, h, 0, kl);
+	}
+	for (size_t j = 0; j < n; j++) {
+		fclose (runs[j].f);
+		free (runs[j].buf);
+		free (runs[j].key);
+		memset (&runs[j], 0, sizeof(struct Run));
+	}
+	free (heap);
+	free (last);
+	return err;
+}
+
+/*
+ * Sort fixed size records of in by keys and write them to out. Input that
+ * fits in half of mem bytes is radix sorted in memory, otherwise every
+ * chunk is sorted into a temporary run file and runs are merged, at most
+ * SORT_RUNS files are open at once. With uniq only first record of every
+ * key is written.
+ * Returns 0, -1 on allocation error, -2 on partial record, -3 on tmp file error.
+ */
+#define SORT_RUNS 64
+int sort_records(FILE* in, FILE* out, size_t rs, struct Key* keys, uint32_t nkeys, size_t kl, uint8_t uniq, size_t mem) {
+	size_t es = kl + sizeof(uint32_t);
+	size_t cap = mem / 2 / (rs + 2 * es);
+	if (cap < 1) cap = 1;
+	if (cap > UINT32_MAX) cap = UINT32_MAX;
+	uint8_t* recs = malloc (cap * rs);
+	uint8_t* ent = malloc (cap * es);
+	uint8_t* tmp = malloc (cap * es);
+	uint8_t* last = malloc (kl);
+	struct Run runs[SORT_RUNS + 1];
+	size_t nruns = 0;
+	int err = recs == NULL || ent == NULL || tmp == NULL || last == NULL ? -1 : 0;
+
+	while (!err) {
+		size_t n = fread (recs, 1, cap * rs, in);
+		if (n % rs) {
+			err = -2;
+			break;
+		}
+		n /= rs;
+		if (n == 0 && nruns) break;
+
+		// all input in memory, no runs needed
+		int c = getc (in);
+		int single = nruns == 0 && c == EOF;
+		if (c != EOF) ungetc (c, in);
+
+		for (size_t j = 0; j < n; j++) {
+			sort_key (ent + j * es, recs + j * rs, keys, nkeys);
+			uint32_t x = j;
+			memcpy (ent + j * es + kl, &x, sizeof(x));
+		}
+		uint8_t* e = radix_sort (ent, tmp, n, es, kl);
+
+		FILE* o = out;
+		if (!single) {
+			// too many runs, merge them into one
+			if (nruns == SORT_RUNS) {
+				FILE* m = tmpfile ();
+				if (m == NULL || merge_runs (runs, nruns, m, rs, mem / 2, keys, nkeys, kl, uniq)) {
+					err = m == NULL ? -3 : -1;
+					if (m) fclose (m);
+					break;
+				}
+				runs[0].f = m;
+				nruns = 1;
+			}
+			memset (&runs[nruns], 0, sizeof(struct Run));
+			o = runs[nruns].f = tmpfile ();
+			if (o == NULL) {
+				err = -3;
+				break;
+			}
+			nruns++;
+		}
+		int have_last = 0;
+		for (size_t j = 0; j < n; j++) {
+			uint8_t* k = e + j * es;
+			if (uniq && have_last && memcmp (last, k, kl) == 0) continue;
+			memcpy (last, k, kl);
+			have_last = 1;
+			uint32_t x;
+			memcpy (&x, k + kl, sizeof(x));
+			if (fwrite (recs + (size_t)x * rs, rs, 1, o) != 1 && o != out) err = -3;
+		}
+		if (single) break;
+	}
+	free (recs);
+	free (ent);
+	free (tmp);
+	free (last);
+
+	if (!err && nruns) return merge_runs (runs, nruns, out, rs, mem / 2, keys, nkeys, kl, uniq);
+	for (size_t j = 0; j < nruns; j++) fclose (runs[j].f);
+	return err;
+}
+
+/*
+ * Length of record of fmts at d when n bytes hold a complete one, 0 when
+ * more data is needed, (size_t)-1 when s string is longer than 255 or
+ * varint longer than 10 bytes. When more is needed and need is not NULL
+ * it gets the least number of bytes that can hold the record.
+ */
+size_t rec_len(struct Fmt* fmts, const uint8_t* d, size_t n, size_t* need) {
+	size_t o = 0, t = 0;
+	for (struct Fmt* i = fmts; i && !t; i = i->next) {
+		if (!fmt_var (i->format)) {
+			size_t e = o + fmt_bytes (i);
+			if (e > n) t = e;
+			else o = e;
+			continue;
+		}
+		for (uint32_t k = 0; k < i->count && !t; k++) {
+			if (i->format == 's') {
+				size_t m = n - o < 256 ? n - o : 256;
+				const uint8_t* z = m ? memchr (d + o, 0, m) : NULL;
+				if (z == NULL && m == 256) return (size_t)-1;
+				if (z == NULL) t = n + 1;
+				else o = z - d + 1;
+			} else if (i->format != 'p') {
+				size_t l = varint_skip (d + o, n - o, i->count - k);
+				if (l == (size_t)-1) return l;
+				if (l == 0) t = n + 1;
+				else o += l;
+				break;
+			} else {
+				size_t e = o >= n ? o + 1 : o + 1 + d[o];
+				if (e > n) t = e;
+				else o = e;
+			}
+		}
+	}
+	if (t == 0) return o;
+	if (need) *need = t;
+	return 0;
+}
+
+/*
+ * Read one record of fmts from in into *buf of *cap bytes (grown as needed)
+ * without reading past it. Returns its length, 0 when input ends before
+ * record does, (size_t)-1 when record is invalid or on allocation error,
+ * *n gets the number of bytes read.
+ */
+size_t rec_read(FILE* in, struct Fmt* fmts, uint8_t** buf, size_t* cap, size_t* n) {
+	*n = 0;
+	for (;;) {
+		size_t need = 0;
+		size_t l = rec_len (fmts, *buf, *n, &need);
+		if (l) return l;
+		if (need > *cap) {
+			size_t c = need < 256 ? 256 : need * 2;
+			uint8_t* b = realloc (*buf, c);
+			if (b == NULL) return (size_t)-1;
+			*buf = b;
+			*cap = c;
+		}
+		size_t r = fread (*buf + *n, 1, need - *n, in);
+		*n += r;
+		if (*n < need) return 0;
+	}
+}
+
+// CRC32C of bytes of record rec before end covered by checksum field c into *v, -1 when there are fewer of them
+int crc_span(struct Fmt* c, const uint8_t* rec, const uint8_t* end, uint32_t* v) {
+	if (c->span > (size_t)(end - rec)) return -1;
+	if (c->span) rec = end - c->span;
+	*v = crc32c (rec, end - rec);
+	return 0;
+}
+
+// first checksum field of fmts covering more bytes than the fixed size fields before it have, NULL when none
+struct Fmt* span_check(struct Fmt* fmts) {
+	size_t pre = 0;
+	for (struct Fmt* i = fmts; i && !fmt_var (i->format); i = i->next) {
+		if (i->format == 'C' && i->span > pre) return i;
+		pre += fmt_bytes (i);
+	}
+	return NULL;
+}
+
+// first checksum field of record d with fields at that does not match, NULL when all do
+struct Fmt* rec_check(struct Fmt* fmts, const uint8_t* d, const uint8_t** at) {
+	for (struct Fmt* i = fmts; i; i = i->next, at++) {
+		if (i->format != 'C') continue;
+		uint32_t v, w;
+		memcpy (&v, *at, 4);
+		endian (i->endian, &v, 4, 1);
+		if (crc_span (i, d, *at, &w) || v != w) return i;
+	}
+	return NULL;
+}
+
+// store start of every field of complete record d in at
+void rec_fields(struct Fmt* fmts, const uint8_t* d, const uint8_t** at) {
+	for (struct Fmt* i = fmts; i; i = i->next) {
+		*at++ = d;
+		if (!fmt_var (i->format)) {
+			d += fmt_bytes (i);
+			continue;
+		}
+		if (i->format == 'v' || i->format == 'z') {
+			d += varint_skip (d, (size_t)10 * i->count, i->count);
+			continue;
+		}
+		for (uint32_t k = 0; k < i->count; k++)
+			d += i->format == 's' ? strlen ((const char*)d) + 1 : 1u + *d;
+	}
+}
+
+// value class of fmt: 's' signed, 'u' unsigned, 'f' floating, 't' text, 'c' char, 'x' pad
+char fmt_class(char format) {
+	switch (format) {
+		case 'b':
+		case 'h':
+		case 'i':
+		case 'q':
+		case 'z': return 's';
+		case 'B':
+		case 'H':
+		case 'I':
+		case 'Q':
+		case 'v': return 'u';
+		case 'f':
+		case 'd': return 'f';
+		case 's':
+		case 'p': return 't';
+	}
+	return format;
+}
+
+// output field of -T and input field it is converted from
+struct Conv {
+	struct Fmt* out;
+	struct Fmt* in;  // NULL for x
+	uint32_t idx;    // index of in field
+};
+
+// load count host order values of format f as int64_t (bits for unsigned) or double,
+// memcpy per element as r may be at any offset of a record
+void load_values(void* v, char f, const void* r, uint32_t count, int as_double) {
+	int64_t* s = v;
+	double* d = v;
+	const uint8_t* b = r;
+	switch (f) {
+		case 'b': for (uint32_t k = 0; k < count; k++) { int8_t x; memcpy (&x, b + k * sizeof(x), sizeof(x)); if (as_double) d[k] = x; else s[k] = x; } break;
+		case 'B': for (uint32_t k = 0; k < count; k++) { uint8_t x; memcpy (&x, b + k * sizeof(x), sizeof(x)); if (as_double) d[k] = x; else s[k] = x; } break;
+		case 'h': for (uint32_t k = 0; k < count; k++) { int16_t x; memcpy (&x, b + k * sizeof(x), sizeof(x)); if (as_double) d[k] = x; else s[k] = x; } break;
+		case 'H': for (uint32_t k = 0; k < count; k++) { uint16_t x; memcpy (&x, b + k * sizeof(x), sizeof(x)); if (as_double) d[k] = x; else s[k] = x; } break;
+		case 'i': for (uint32_t k = 0; k < count; k++) { int32_t x; memcpy (&x, b + k * sizeof(x), sizeof(x)); if (as_double) d[k] = x; else s[k] = x; } break;
+		case 'I': for (uint32_t k = 0; k < count; k++) { uint32_t x; memcpy (&x, b + k * sizeof(x), sizeof(x)); if (as_double) d[k] = x; else s[k] = x; } break;
+		case 'q': for (uint32_t k = 0; k < count; k++) { int64_t x; memcpy (&x, b + k * sizeof(x), sizeof(x)); if (as_double) d[k] = x; else s[k] = x; } break;
+		case 'Q': for (uint32_t k = 0; k < count; k++) { uint64_t x; memcpy (&x, b + k * sizeof(x), sizeof(x)); if (as_double) d[k] = x; else s[k] = x; } break;
+		case 'f': for (uint32_t k = 0; k < count; k++) { float x; memcpy (&x, b + k * sizeof(x), sizeof(x)); d[k] = x; } break;
+		case 'd': for (uint32_t k = 0; k < count; k++) { double x; memcpy (&x, b + k * sizeof(x), sizeof(x)); d[k] = x; } break;
+	}
+}
+
+// store count int64_t (or double for f d) values as host order format f at r of any alignment
+void store_values(void* r, char f, const void* v, uint32_t count) {
+	const int64_t* s = v;
+	const double* d = v;
+	uint8_t* b = r;
+	switch (f) {
+		case 'b': for (uint32_t k = 0; k < count; k++) { int8_t x = s[k]; memcpy (b + k * sizeof(x), &x, sizeof(x)); } break;
+		case 'B': for (uint32_t k = 0; k < count; k++) { uint8_t x = s[k]; memcpy (b + k * sizeof(x), &x, sizeof(x)); } break;
+		case 'h': for (uint32_t k = 0; k < count; k++) { int16_t x = s[k]; memcpy (b + k * sizeof(x), &x, sizeof(x)); } break;
+		case 'H': for (uint32_t k = 0; k < count; k++) { uint16_t x = s[k]; memcpy (b + k * sizeof(x), &x, sizeof(x)); } break;
+		case 'i': for (uint32_t k = 0; k < count; k++) { int32_t x = s[k]; memcpy (b + k * sizeof(x), &x, sizeof(x)); } break;
+		case 'I': for (uint32_t k = 0; k < count; k++) { uint32_t x = s[k]; memcpy (b + k * sizeof(x), &x, sizeof(x)); } break;
+		case 'q': for (uint32_t k = 0; k < count; k++) { int64_t x = s[k]; memcpy (b + k * sizeof(x), &x, sizeof(x)); } break;
+		case 'Q': for (uint32_t k = 0; k < count; k++) { uint64_t x = s[k]; memcpy (b + k * sizeof(x), &x, sizeof(x)); } break;
+		case 'f': for (uint32_t k = 0; k < count; k++) { float x = d[k]; memcpy (b + k * sizeof(x), &x, sizeof(x)); } break;
+		case 'd': for (uint32_t k = 0; k < count; k++) { double x = d[k]; memcpy (b + k * sizeof(x), &x, sizeof(x)); } break;
+	}
+}
+
+/*
+ * Pack array field i of fixed size elements from vals at *argv straight to
+ * out, ARR_MAX of them at a time, so memory does not grow with count. Whole
+ * c array comes from one val, nul padded. Returns 0, -1 on allocation error
+ * or -2 when vals run out.
+ */
+int arr_pack(FILE* out, struct Fmt* i, char*** argv, uint8_t pad_byte) {
+	size_t s = fmt_size (i->format), l = 0;
+	const char* c = NULL;
+	if (i->format == 'c') {
+		if (**argv == NULL) return -2;
+		c = *(*argv)++;
+		l = strlen (c);
+	}
+	uint8_t* b = malloc (s * ARR_MAX);
+	int64_t* v = malloc (sizeof(int64_t) * ARR_MAX);
+	if (b == NULL || v == NULL) {
+		free (b);
+		free (v);
+		return -1;
+	}
+	int err = 0;
+	for (uint64_t k = 0, m; k < i->count && !err; k += m) {
+		m = i->count - k < ARR_MAX ? i->count - k : ARR_MAX;
+		for (uint32_t j = 0; j < m && !err; j++) {
+			if (i->format == 'x') b[j] = pad_byte;
+			else if (i->format == 'c') b[j] = k + j < l ? c[k + j] : 0;
+			else if (**argv == NULL) err = -2;
+			else if (i->format == 'f') ((float*)b)[j] = strtof (*(*argv)++, NULL);
+			else if (i->format == 'd') ((double*)b)[j] = strtod (*(*argv)++, NULL);
+			else if (strchr ("bhiq", i->format)) v[j] = strtoll (*(*argv)++, NULL, 0);
+			else v[j] = strtoull (*(*argv)++, NULL, 0);
+		}
+		if (err) break;
+		if (strchr ("bBhHiIqQ", i->format)) store_values (b, i->format, v, m);
+		endian (i->endian, b, s, m);
+		fwrite (b, s, m, out);
+	}
+	free (b);
+	free (v);
+	return err;
+}
+
+/*
+ * Read array field i of fixed size elements from in and print it to out as
+ * "name: v1, v2, ...", ARR_MAX elements at a time. Returns 0, -1 on
+ * allocation error or -2 when input ends.
+ */
+int arr_unpack(FILE* in, FILE* out, struct Fmt* i, uint32_t max_name_size) {
+	size_t s = fmt_size (i->format);
+	uint8_t* b = malloc (s * ARR_MAX);
+	if (b == NULL) return -1;
+	struct Fmt c = *i;
+	print_name (out, i, max_name_size);
+	for (uint64_t k = 0; k < i->count; k += c.count) {
+		c.count = i->count - k < ARR_MAX ? i->count - k : ARR_MAX;
+		if (fread (b, s, c.count, in) != c.count) {
+			free (b);
+			return -2;
+		}
+		endian (c.endian, b, s, c.count);
+		if (k && c.format != 'x' && c.format != 'c') fprintf (out, ", ");
+		print_values (out, &c, b);
+	}
+	if (i->format != 'x') fprintf (out, "\n");
+	free (b);
+	return 0;
+}
+
+/*
+ * Convert field f at p into field t at o, tmp and raw hold count 8 byte values.
+ * Same fmt is a copy with optional swap, other numbers go through int64_t
+ * or double arrays with range check, varints are decoded as q or Q first.
+ * Returns written bytes or -1 when a value does not fit into t.
+ */
+int64_t conv_field(uint8_t* o, struct Fmt* t, const uint8_t* p, struct Fmt* f, void* tmp, uint8_t* raw) {
+	size_t ss = fmt_size (f->format), ds = fmt_size (t->format);
+	uint32_t n = f->count;
+	char sc = fmt_class (f->format), dc = fmt_class (t->format);
+
+	if (sc == 't') {
+		uint8_t* b = o;
+		for (uint32_t k = 0; k < n; k++) {
+			size_t l = f->format == 's' ? strlen ((const char*)p) : *p++;
+			if (t->format == 'p') *o++ = l;
+			memcpy (o, p, l);
+			o += l;
+			if (t->format == 's') *o++ = 0;
+			p += f->format == 's' ? l + 1 : l;
+		}
+		return o - b;
+	}
+	if (f->format == t->format && fmt_var (f->format)) {
+		size_t l = varint_skip (p, (size_t)10 * n, n);
+		memcpy (o, p, l);
+		return l;
+	}
+	if (f->format == t->format) {
+		memcpy (o, p, ss * n);
+		char se = f->endian == '@' ? HOST_ENDIAN : f->endian;
+		char de = t->endian == '@' ? HOST_ENDIAN : t->endian;
+		if (se != de) endian (HOST_ENDIAN == '<' ? '>' : '<', o, ss, n);
+		return ss * n;
+	}
+
+	char lf = f->format;
+	if (fmt_var (lf)) {
+		varint_get ((uint64_t*)raw, n, p, varint_skip (p, (size_t)10 * n, n), lf == 'z');
+		lf = lf == 'z' ? 'q' : 'Q';
+	} else {
+		memcpy (raw, p, ss * n);
+		endian (f->endian, raw, ss, n);
+	}
+	if (dc == 'f') {
+		load_values (tmp, lf, raw, n, 1);
+		// finite doubles beyond float range would turn into inf
+		double* d = tmp;
+		for (uint32_t k = 0; t->format == 'f' && k < n; k++)
+			if (d[k] - d[k] == 0 && (d[k] > FLT_MAX || d[k] < -FLT_MAX)) return -1;
+	} else {
+		int w = ds ? ds * 8 : 64;
+		uint64_t hi = dc == 's' ? (1ull << (w - 1)) - 1 : w == 64 ? UINT64_MAX : (1ull << w) - 1;
+		int64_t lo = dc == 's' ? -(int64_t)(hi) - 1 : 0;
+		int ok = 1;
+		if (sc == 'f') {
+			double* d = tmp;
+			load_values (tmp, lf, raw, n, 1);
+			for (uint32_t k = 0; k < n; k++) {
+				// check value the cast truncates to, doubles from 2^52 up have no fraction
+				double x = d[k];
+				if (x > -4503599627370496.0 && x < 4503599627370496.0) x = (double)(int64_t)x;
+				ok &= x >= (double)lo && x < (double)hi + 1.0;
+			}
+			if (!ok) return -1;
+			int64_t* v = tmp;
+			for (uint32_t k = 0; k < n; k++)
+				v[k] = d[k] < 0 ? (int64_t)d[k] : (int64_t)(uint64_t)d[k];
+		} else {
+			int64_t* v = tmp;
+			load_values (tmp, lf, raw, n, 0);
+			for (uint32_t k = 0; k < n; k++)
+				ok &= sc == 's' && v[k] < 0 ? v[k] >= lo : (uint64_t)v[k] <= hi;
+			if (!ok) return -1;
+		}
+	}
+	if (fmt_var (t->format)) {
+		uint8_t* b = o;
+		for (uint32_t k = 0; k < n; k++)
+			o += varint_put (o, ((int64_t*)tmp)[k], t->format == 'z');
+		return o - b;
+	}
+	store_values (o, t->format, tmp, n);
+	endian (t->endian, o, ds, n);
+	return ds * n;
+}
+
+/*
+ * Checkpoint of -c: after every every records the output is flushed to disk
+ * and file path is replaced by line "sp-ckpt1 KEY IN REC OUT" of input offset
+ * in, next record number rec and output offset out of the same record
+ * boundary. KEY tells jobs apart. Restarted job seeks input to in, cuts
+ * output at out and goes on from record rec.
+ */
+struct Ckpt {
+	const char* path;
+	uint64_t every;
+	uint64_t key, in, rec, out;
+};
+
+// read checkpoint of c->path, zeros when there is none. -1 on bad or foreign one
+int ckpt_load(struct Ckpt* c) {
+	c->in = c->rec = c->out = 0;
+	FILE* f = fopen (c->path, "r");
+	if (f == NULL) return 0;
+	unsigned long long k, i, r, o;
+	int ok = fscanf (f, "sp-ckpt1 %llx %llu %llu %llu", &k, &i, &r, &o) == 4 && k == c->key;
+	fclose (f);
+	if (!ok) return -1;
+	c->in = i;
+	c->rec = r;
+	c->out = o;
+	return 0;
+}
+
+// flush out and record boundary at input offset in before record rec into c->path, -1 on error
+int ckpt_save(struct Ckpt* c, FILE* out, uint64_t in, uint64_t rec) {
+	char t[4096];
+	off_t o;
+	if (fflush (out) || fdatasync (fileno (out)) || (o = ftello (out)) < 0 ||
+			snprintf (t, sizeof(t), "%s.tmp", c->path) >= (int)sizeof(t))
+		return -1;
+	FILE* f = fopen (t, "w");
+	if (f == NULL) return -1;
+	int e = fprintf (f, "sp-ckpt1 %llx %llu %llu %llu\n", (unsigned long long)c->key,
+		(unsigned long long)in, (unsigned long long)rec, (unsigned long long)o) < 0;
+	e |= fflush (f) || fsync (fileno (f));
+	e |= fclose (f);
+	// rename keeps old checkpoint whole till new one is
+	if (e || rename (t, c->path)) return -1;
+	c->in = in;
+	c->rec = rec;
+	c->out = o;
+	return 0;
+}
+
+/*
+ * Convert records of ifmts from in into records of ofmts on out. Records
+ * whose checksums do not match are skipped and counted in *skipped, output
+ * checksums are computed. With ck checkpoints are written and input is
+ * taken to start at record ck->rec. Returns 0, -1 on allocation error, -2
+ * on partial or invalid record, -3 when value does not fit, *recno and *bad
+ * tell where, -4 when checkpoint can not be written, -5 when output record
+ * has fewer bytes than its checksum covers.
+ */
+int transcode(FILE* in, FILE* out, struct Fmt* ifmts, struct Conv* cv, uint32_t ncv, uint8_t pad_byte, uint64_t* recno, struct Conv** bad, uint64_t* skipped, struct Ckpt* ck) {
+	uint32_t nin = 0, maxc = 1, crc = 0;
+	size_t omax = 0, imax = 0;
+	for (struct Fmt* i = ifmts; i; i = i->next, nin++) {
+		imax += fmt_max (i->format) * i->count;
+		if (maxc < i->count) maxc = i->count;
+		crc |= i->format == 'C';
+	}
+	for (uint32_t j = 0; j < ncv; j++)
+		omax += fmt_max (cv[j].out->format) * cv[j].out->count;
+
+	size_t cap = imax * 2 > (1 << 20) ? imax * 2 : (1 << 20);
+	uint8_t* buf = malloc (cap);
+	uint8_t* obuf = malloc (omax ? omax : 1);
+	uint8_t* raw = malloc (maxc * 8);
+	int64_t* tmp = malloc (maxc * 8);
+	const uint8_t** at = malloc (nin * sizeof(uint8_t*));
+	int err = buf == NULL || obuf == NULL || raw == NULL || tmp == NULL || at == NULL ? -1 : 0;
+
+	*recno = ck ? ck->rec : 0;
+	*skipped = 0;
+	size_t n = 0;
+	uint64_t pos = ck ? ck->in : 0;
+	for (int eof = 0; !err && !eof; ) {
+		size_t r = fread (buf + n, 1, cap - n, in);
+		eof = r == 0;
+		n += r;
+		size_t off = 0;
+		for (size_t l; !err && (l = rec_len (ifmts, buf + off, n - off, NULL)); ) {
+			if (l == (size_t)-1) {
+				err = -2;
+				break;
+			}
+			rec_fields (ifmts, buf + off, at);
+			if (crc && rec_check (ifmts, buf + off, at)) {
+				off += l;
+				pos += l;
+				++*recno;
+				++*skipped;
+				continue;
+			}
+			uint8_t* o = obuf;
+			for (uint32_t j = 0; j < ncv; j++) {
+				struct Conv* c = &cv[j];
+				if (c->out->format == 'C') {
+					uint32_t v;
+					if (crc_span (c->out, obuf, o, &v)) {
+						*bad = c;
+						err = -5;
+						break;
+					}
+					endian (c->out->endian, &v, sizeof(v), 1);
+					memcpy (o, &v, sizeof(v));
+					o += sizeof(v);
+					continue;
+				}
+				if (c->in == NULL) {
+					memset (o, pad_byte, c->out->count);
+					o += c->out->count;
+					continue;
+				}
+				int64_t w = conv_field (o, c->out, at[c->idx], c->in, tmp, raw);
+				if (w < 0) {
+					*bad = c;
+					err = -3;
+					break;
+				}
+				o += w;
+			}
+			if (err) break;
+			fwrite (obuf, o - obuf, 1, out);
+			off += l;
+			pos += l;
+			++*recno;
+			if (ck && *recno - ck->rec >= ck->every && ckpt_save (ck, out, pos, *recno)) err = -4;
+		}
+		memmove (buf, buf + off, n - off);
+		n -= off;
+		if (eof && n && !err) err = -2;
+	}
+	free (buf);
+	free (obuf);
+	free (raw);
+	free (tmp);
+	free (at);
+	return err;
+}
+
+
+/*
+ * First occurrence of l bytes of m in n bytes of d, NULL when none. First
+ * and last byte of m are compared at 16 positions at once, only positions
+ * where both match are compared whole.
+ */
+const uint8_t* find_marker(const uint8_t* d, size_t n, const uint8_t* m, size_t l) {
+	if (l == 1) return memchr (d, m[0], n);
+	if (n < l) return NULL;
+	size_t j = 0;
+#ifdef __SSE2__
+	__m128i f = _mm_set1_epi8 (m[0]), e = _mm_set1_epi8 (m[l - 1]);
+	for (; j + l - 1 + 16 <= n; j += 16) {
+		__m128i a = _mm_loadu_si128 ((const __m128i*)(d + j));
+		__m128i b = _mm_loadu_si128 ((const __m128i*)(d + j + l - 1));
+		unsigned hit = _mm_movemask_epi8 (_mm_and_si128 (_mm_cmpeq_epi8 (a, f), _mm_cmpeq_epi8 (b, e)));
+		for (; hit; hit &= hit - 1) {
+			unsigned k = __builtin_ctz (hit);
+			if (memcmp (d + j + k + 1, m + 1, l - 2) == 0) return d + j + k;
+		}
+	}
+#endif
+	for (; j + l <= n; j++) {
+		const uint8_t* p = memchr (d + j, m[0], n - l + 1 - j);
+		if (p == NULL) return NULL;
+		if (memcmp (p, m, l) == 0) return p;
+		j = p - d;
+	}
+	return NULL;
+}
+
+// host order values of field i at p of record ending at end into v, the way print_values wants them
+void field_load(struct Fmt* i, const uint8_t* p, const uint8_t* end, uint8_t* v) {
+	if (i->bits) {
+		bits_load ((uint64_t*)v, i, p, end);
+	} else if (i->format == 'v' || i->format == 'z') {
+		varint_get ((uint64_t*)v, i->count, p, end - p, i->format == 'z');
+	} else if (i->format == 'p') {
+		for (uint32_t k = 0; k < i->count; k++) {
+			uint8_t l = *p++;
+			memcpy (v, p, l);
+			v[l] = 0;
+			v += l + 1;
+			p += l;
+		}
+	} else if (i->format == 's') {
+		const uint8_t* q = p;
+		for (uint32_t k = 0; k < i->count; k++) q += strlen ((const char*)q) + 1;
+		memcpy (v, p, q - p);
+	} else {
+		memcpy (v, p, fmt_bytes (i));
+		endian (i->endian, v, fmt_size (i->format), i->count);
+	}
+}
+
+// value of single integer field i at p of record ending at end
+int64_t field_int(struct Fmt* i, const uint8_t* p, const uint8_t* end) {
+	uint64_t v = 0;
+	int64_t x = 0;
+	field_load (i, p, end, (uint8_t*)&v);
+	load_values (&x, i->format == 'v' ? 'Q' : i->format == 'z' ? 'q' : i->format, &v, 1, 0);
+	return x;
+}
+
+// largest record of fmts in bytes, *vmax gets bytes field_load needs for largest field
+size_t rec_max(struct Fmt* fmts, size_t* vmax) {
+	size_t imax = 0;
+	*vmax = 8;
+	for (struct Fmt* i = fmts; i; i = i->next) {
+		imax += fmt_var (i->format) ? fmt_max (i->format) * i->count : fmt_bytes (i);
+		size_t s = (fmt_max (i->format) > 8 ? fmt_max (i->format) : 8) * i->count;
+		if (*vmax < s) *vmax = s;
+	}
+	return imax;
+}
+
+// print fields of record p of l bytes starting at at as "[label] name: value"
+// or "[src label] name: value" when src is not NULL, v is field_load buffer
+void rec_print(FILE* out, struct Fmt* fmts, const uint8_t* p, size_t l, const uint8_t** at, uint8_t* v, const char* src, uint64_t label, uint32_t max_name_size) {
+	for (struct Fmt* i = fmts; i; i = i->next, at++) {
+		if (i->format == 'x') continue;
+		field_load (i, *at, p + l, v);
+		if (src) fprintf (out, "[%s %llu] ", src, (unsigned long long)label);
+		else fprintf (out, "[%llu] ", (unsigned long long)label);
+		print_name (out, i, max_name_size);
+		print_values (out, i, v);
+		fprintf (out, "\n");
+	}
+}
+
+/*
+ * Decode record of fmts at every marker m (ml bytes) in in and print it as
+ * "[offset] name: value". A match is passed over when its record is invalid,
+ * cut by end of input, its checksums do not match, or field len (when not
+ * NULL) does not hold the number of record bytes after it. Returns 0 or -1
+ * on allocation error, *recs gets records found, *skipped bytes outside them.
+ */
+int scan(FILE* in, FILE* out, struct Fmt* fmts, const uint8_t* m, size_t ml, struct Fmt* len, uint32_t max_name_size, uint64_t* recs, uint64_t* skipped) {
+	uint32_t nf = 0, crc = 0, li = 0;
+	size_t vmax, imax = rec_max (fmts, &vmax);
+	for (struct Fmt* i = fmts; i; i = i->next, nf++) {
+		crc |= i->format == 'C';
+		if (i == len) li = nf;
+	}
+
+	size_t cap = imax * 2 > (1 << 20) ? imax * 2 : (1 << 20);
+	uint8_t* buf = malloc (cap);
+	uint8_t* v = malloc (vmax);
+	const uint8_t** at = malloc (nf * sizeof(uint8_t*));
+	int err = buf == NULL || v == NULL || at == NULL ? -1 : 0;
+
+	*recs = 0;
+	*skipped = 0;
+	uint64_t base = 0, last = 0; // input offset of buf, end of last record
+	size_t n = 0, pos = 0;
+	for (int eof = 0; !err && !eof; ) {
+		size_t r = fread (buf + n, 1, cap - n, in);
+		eof = r == 0;
+		n += r;
+		for (;;) {
+			const uint8_t* p = find_marker (buf + pos, n - pos, m, ml);
+			if (p == NULL) {
+				// keep tail which may be start of marker
+				if (n - pos >= ml) pos = n - ml + 1;
+				break;
+			}
+			pos = p - buf;
+			size_t l = rec_len (fmts, p, n - pos, NULL);
+			if (l == 0 && !eof) break;
+			int ok = l && l != (size_t)-1;
+			if (ok) {
+				rec_fields (fmts, p, at);
+				ok = !crc || rec_check (fmts, p, at) == NULL;
+			}
+			if (ok && len) {
+				const uint8_t* e = len->next ? at[li + 1] : p + l;
+				ok = (uint64_t)field_int (len, at[li], p + l) == (uint64_t)(p + l - e);
+			}
+			if (!ok) {
+				pos++;
+				continue;
+			}
+
+			rec_print (out, fmts, p, l, at, v, NULL, base + pos, max_name_size);
+			++*recs;
+			*skipped += base + pos - last;
+			last = base + pos + l;
+			pos += l;
+		}
+		memmove (buf, buf + pos, n - pos);
+		base += pos;
+		n -= pos;
+		pos = 0;
+	}
+	*skipped += base + n - last;
+	free (buf);
+	free (v);
+	free (at);
+	return err;
+}
+
+// body layout of one tag of -U
+struct Union {
+	int64_t tag;
+	struct Fmt* fmts;
+};
+
+int union_cmp(const void* a, const void* b) {
+	int64_t x = ((const struct Union*)a)->tag, y = ((const struct Union*)b)->tag;
+	return (x > y) - (x < y);
+}
+
+/*
+ * Decode records made of header head and body of u (nu entries sorted by
+ * tag) chosen by value of header field tagf, print them as "[record] name:
+ * value". Tags spanning up to 64k values are looked up in a dense table,
+ * others by binary search. Field len of header, when not NULL, holds the
+ * number of record bytes after it: records are advanced by it and records
+ * of unknown tags are skipped (counted in *unknown). Returns 0, -1 on
+ * allocation error, -2 on partial or invalid record, -3 on unknown tag
+ * without len, *recno tells where.
+ */
+int dispatch(FILE* in, FILE* out, struct Fmt* head, struct Fmt* tagf, struct Fmt* len, struct Union* u, uint32_t nu, uint32_t max_name_size, uint64_t* recno, uint64_t* unknown) {
+	uint32_t nh = 0, nb = 0, ti = 0, li = 0;
+	for (struct Fmt* i = head; i; i = i->next, nh++) {
+		if (i == tagf) ti = nh;
+		if (i == len) li = nh;
+	}
+	size_t vmax, s, bmax = 0, hmax = rec_max (head, &vmax);
+	for (uint32_t j = 0; j < nu; j++) {
+		uint32_t c = 0;
+		for (struct Fmt* i = u[j].fmts; i; i = i->next) c++;
+		if (nb < c) nb = c;
+		size_t m = rec_max (u[j].fmts, &s);
+		if (bmax < m) bmax = m;
+		if (vmax < s) vmax = s;
+	}
+
+	// dense table from smallest tag when tags are close enough
+	uint64_t range = (uint64_t)u[nu - 1].tag - (uint64_t)u[0].tag + 1;
+	struct Union** lut = range <= 65536 ? calloc (range, sizeof(struct Union*)) : NULL;
+	for (uint32_t j = 0; lut && j < nu; j++) lut[u[j].tag - u[0].tag] = &u[j];
+
+	size_t cap = (hmax + bmax) * 2 > (1 << 20) ? (hmax + bmax) * 2 : (1 << 20);
+	uint8_t* buf = malloc (cap);
+	uint8_t* v = malloc (vmax);
+	const uint8_t** hat = malloc (nh * sizeof(uint8_t*));
+	const uint8_t** bat = malloc ((nb ? nb : 1) * sizeof(uint8_t*));
+	int err = buf == NULL || v == NULL || hat == NULL || bat == NULL || (range <= 65536 && lut == NULL) ? -1 : 0;
+
+	*recno = 0;
+	*unknown = 0;
+	uint64_t skip = 0; // bytes of long unknown record not read yet
+	size_t n = 0;
+	for (int eof = 0; !err && !eof; ) {
+		size_t r = fread (buf + n, 1, cap - n, in);
+		eof = r == 0;
+		n += r;
+		size_t off = skip < n ? skip : n;
+		skip -= off;
+		while (off < n) {
+			const uint8_t* d = buf + off;
+			size_t m = n - off;
+			size_t hl = rec_len (head, d, m, NULL);
+			if (hl == 0) break;
+			if (hl == (size_t)-1) {
+				err = -2;
+				break;
+			}
+			rec_fields (head, d, hat);
+			int64_t tag = field_int (tagf, hat[ti], d + hl);
+			uint64_t rl = 0;
+			if (len) {
+				const uint8_t* e = len->next ? hat[li + 1] : d + hl;
+				rl = (e - d) + (uint64_t)field_int (len, hat[li], d + hl);
+				if (rl < hl) {
+					err = -2;
+					break;
+				}
+			}
+
+			struct Union* b = NULL;
+			if (lut) {
+				if ((uint64_t)tag - (uint64_t)u[0].tag < range) b = lut[tag - u[0].tag];
+			} else {
+				struct Union k = { tag, NULL };
+				b = bsearch (&k, u, nu, sizeof(k), union_cmp);
+			}
+			if (b == NULL) {
+				if (len == NULL) {
+					err = -3;
+					break;
+				}
+				if (rl > m && rl <= cap) break;
+				if (rl > m) skip = rl - m;
+				off += rl > m ? m : rl;
+				++*unknown;
+				++*recno;
+				continue;
+			}
+
+			// wait for whole record, body has to fit in it
+			if (len && rl > m) {
+				if (rl > cap) err = -2;
+				break;
+			}
+			size_t bl = rec_len (b->fmts, d + hl, (len ? rl : m) - hl, NULL);
+			if (bl == 0 && len == NULL) break;
+			if (bl == 0 || bl == (size_t)-1) {
+				err = -2;
+				break;
+			}
+			rec_fields (b->fmts, d + hl, bat);
+			struct Fmt* bad = rec_check (head, d, hat);
+			if (bad == NULL) bad = rec_check (b->fmts, d, bat);
+			if (bad) {
+				fprintf (stderr, "WARNING: record %llu checksum '%s' does not match\n", (unsigned long long)*recno, bad->name ? bad->name : "C");
+			} else {
+				rec_print (out, head, d, hl + bl, hat, v, NULL, *recno, max_name_size);
+				rec_print (out, b->fmts, d, hl + bl, bat, v, NULL, *recno, max_name_size);
+			}
+			off += len ? rl : hl + bl;
+			++*recno;
+		}
+		if (err) break;
+		memmove (buf, buf + off, n - off);
+		n -= off;
+		if (eof && (n || skip)) err = -2;
+	}
+	free (lut);
+	free (buf);
+	free (v);
+	free (hat);
+	free (bat);
+	return err;
+}
+
+#ifdef __linux__
+/*
+ * Decode complete records of fmts in n bytes of d and print them as
+ * "[recno] name: value" (or "[src recno] ..." when src is not NULL), records
+ * with bad checksum are reported and passed over. Returns bytes used, a
+ * trailing partial record is left for later, or (size_t)-1 on invalid record.
+ */
+size_t rec_stream(FILE* out, struct Fmt* fmts, const uint8_t* d, size_t n, const uint8_t** at, uint8_t* v, const char* src, uint64_t* recno, uint32_t max_name_size) {
+	size_t off = 0;
+	for (size_t l; (l = rec_len (fmts, d + off, n - off, NULL)); off += l, ++*recno) {
+		if (l == (size_t)-1) return l;
+		rec_fields (fmts, d + off, at);
+		struct Fmt* bad = rec_check (fmts, d + off, at);
+		if (bad) fprintf (stderr, "WARNING: record %s%s%llu checksum '%s' does not match\n", src ? src : "", src ? " " : "", (unsigned long long)*recno, bad->name ? bad->name : "C");
+		else rec_print (out, fmts, d + off, l, at, v, src, *recno, max_name_size);
+	}
+	return off;
+}
+
+/*
+ * Decode records of fmts in file path, then keep waiting with inotify for
+ * appended ones. A partial record at the end is held back till the rest
+ * arrives. When path gets replaced (rotation) the old file is read to its
+ * end and the new one is followed from its start, truncated file is read
+ * again from start. Returns only on error: -1 allocation, -2 open or read,
+ * -3 invalid record.
+ */
+int follow(const char* path, FILE* out, struct Fmt* fmts, uint32_t max_name_size) {
+	uint32_t nf = 0;
+	for (struct Fmt* i = fmts; i; i = i->next) nf++;
+	size_t vmax, imax = rec_max (fmts, &vmax);
+	size_t cap = imax * 2 > (1 << 20) ? imax * 2 : (1 << 20);
+	uint8_t* buf = malloc (cap);
+	uint8_t* v = malloc (vmax);
+	const uint8_t** at = malloc (nf * sizeof(uint8_t*));
+	char* dir = strdup (path);
+	int fd = open (path, O_RDONLY);
+	int ino = inotify_init1 (IN_CLOEXEC);
+	int err = buf == NULL || v == NULL || at == NULL || dir == NULL ? -1 : fd < 0 || ino < 0 ? -2 : 0;
+
+	// watch file for appends and directory for new file of same name
+	uint32_t fmask = IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+	int wf = err ? -1 : inotify_add_watch (ino, path, fmask);
+	if (!err && (wf < 0 || inotify_add_watch (ino, dirname (dir), IN_CREATE | IN_MOVED_TO) < 0)) err = -2;
+
+	uint64_t recno = 0;
+	off_t pos = 0;
+	size_t n = 0;
+	while (!err) {
+		ssize_t r = read (fd, buf + n, cap - n);
+		if (r < 0) {
+			err = -2;
+			break;
+		}
+		if (r > 0) {
+			pos += r;
+			n += r;
+			size_t u = rec_stream (out, fmts, buf, n, at, v, NULL, &recno, max_name_size);
+			if (u == (size_t)-1) {
+				err = -3;
+				break;
+			}
+			memmove (buf, buf + u, n - u);
+			n -= u;
+			continue;
+		}
+		fflush (out);
+
+		// at end of file, switch to new file when path was replaced
+		struct stat a, b;
+		if (stat (path, &a) == 0 && fstat (fd, &b) == 0 && (a.st_ino != b.st_ino || a.st_dev != b.st_dev)) {
+			if (n) fprintf (stderr, "WARNING: %zu bytes of partial record dropped at end of rotated file\n", n);
+			int nfd = open (path, O_RDONLY);
+			if (nfd < 0) continue; // gone again, wait for next one
+			close (fd);
+			fd = nfd;
+			inotify_rm_watch (ino, wf);
+			wf = inotify_add_watch (ino, path, fmask);
+			if (wf < 0) err = -2;
+			pos = 0;
+			n = 0;
+			continue;
+		}
+		if (fstat (fd, &b) == 0 && b.st_size < pos) {
+			if (n) fprintf (stderr, "WARNING: %zu bytes of partial record dropped, file truncated\n", n);
+			lseek (fd, 0, SEEK_SET);
+			pos = 0;
+			n = 0;
+			continue;
+		}
+
+		// sleep till something happens to file or directory
+		char ev[4096];
+		if (read (ino, ev, sizeof(ev)) < 0) err = -2;
+	}
+	free (buf);
+	free (v);
+	free (at);
+	free (dir);
+	if (fd >= 0) close (fd);
+	if (ino >= 0) close (ino);
+	return err;
+}
+
+// one input of -I with its own fmt and buffer of partial record
+struct Src {
+	char* label;
+	char* path;
+	struct Fmt* fmts;
+	int fd;
+	uint8_t* buf;
+	size_t cap;
+	size_t n;
+	uint64_t recno;
+};
+
+/*
+ * Decode records of ns inputs s at once as they arrive and print them to out
+ * as "[label recno] name: value". Inputs are read without blocking when
+ * epoll reports data, each into its own buffer bounded by twice its largest
+ * record. Output is flushed whenever no input is ready. An input ends with
+ * its writer, returns when all did: 0, -1 on allocation error, -2 when
+ * input can not be opened, polled or read, -3 on invalid record, *bad gets
+ * index of failed input.
+ */
+int mux(FILE* out, struct Src* s, uint32_t ns, uint32_t max_name_size, uint32_t* bad) {
+	uint32_t nf = 0;
+	size_t vmax = 8;
+	int ep = epoll_create1 (EPOLL_CLOEXEC);
+	int err = ep < 0 ? -2 : 0;
+	for (uint32_t j = 0; j < ns; j++) {
+		s[j].fd = -1;
+		s[j].buf = NULL;
+	}
+	for (uint32_t j = 0; j < ns && !err; j++) {
+		uint32_t c = 0;
+		for (struct Fmt* i = s[j].fmts; i; i = i->next) c++;
+		if (nf < c) nf = c;
+		size_t x, imax = rec_max (s[j].fmts, &x);
+		if (vmax < x) vmax = x;
+		s[j].cap = imax * 2 > 65536 ? imax * 2 : 65536;
+		s[j].buf = malloc (s[j].cap);
+		s[j].n = 0;
+		s[j].recno = 0;
+		if (s[j].buf == NULL) err = -1;
+		s[j].fd = err ? -1 : open (s[j].path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		struct epoll_event e = { .events = EPOLLIN, .data.u32 = j };
+		if (!err && (s[j].fd < 0 || epoll_ctl (ep, EPOLL_CTL_ADD, s[j].fd, &e))) err = -2;
+		if (err) *bad = j;
+	}
+	uint8_t* v = malloc (vmax);
+	const uint8_t** at = malloc (nf * sizeof(uint8_t*) + 1);
+	if (!err && (v == NULL || at == NULL)) err = -1;
+
+	struct epoll_event ev[64];
+	for (uint32_t live = ns; !err && live; ) {
+		int k = epoll_wait (ep, ev, 64, 0);
+		if (k == 0) {
+			fflush (out);
+			k = epoll_wait (ep, ev, 64, -1);
+		}
+		if (k < 0 && errno != EINTR) err = -2;
+		for (int e = 0; e < k && !err; e++) {
+			struct Src* c = &s[ev[e].data.u32];
+			ssize_t r = read (c->fd, c->buf + c->n, c->cap - c->n);
+			if (r < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+			if (r > 0) {
+				c->n += r;
+				size_t u = rec_stream (out, c->fmts, c->buf, c->n, at, v, c->label, &c->recno, max_name_size);
+				if (u == (size_t)-1) {
+					err = -3;
+					*bad = c - s;
+					break;
+				}
+				memmove (c->buf, c->buf + u, c->n - u);
+				c->n -= u;
+				continue;
+			}
+			if (r < 0) {
+				err = -2;
+				*bad = c - s;
+				break;
+			}
+			if (c->n) fprintf (stderr, "WARNING: %zu bytes of partial record dropped at end of '%s'\n", c->n, c->label);
+			epoll_ctl (ep, EPOLL_CTL_DEL, c->fd, NULL);
+			close (c->fd);
+			c->fd = -1;
+			live--;
+		}
+	}
+	fflush (out);
+	for (uint32_t j = 0; j < ns; j++) {
+		if (s[j].fd >= 0) close (s[j].fd);
+		free (s[j].buf);
+		s[j].buf = NULL;
+	}
+	free (v);
+	free (at);
+	if (ep >= 0) close (ep);
+	return err;
+}
+
+/*
+ * Shared memory ring of -O and -Q. POSIX shm object "/NAME" holds this
+ * header followed by size data bytes, size is a power of 2. It carries a
+ * byte stream from one producer to one consumer: head counts bytes ever
+ * written, tail bytes ever read, stream byte n lives at data[n & (size-1)].
+ * Producer copies bytes in below tail + size and then moves head, consumer
+ * copies bytes out below head and then moves tail, no locks. Side finding
+ * the ring empty (full) sets rwait (wwait), checks again and sleeps on
+ * futex word hseq (tseq), other side bumps that word and wakes it after
+ * moving its index when the flag is set. Producer sets closed at end,
+ * consumer drains the ring, sees end of stream and removes the object.
+ * Consumer also ends when producer pid is gone. Consumer sets rpid to its
+ * pid and to -1 when it leaves, producer then fails like on a pipe without
+ * reader (SIGPIPE, EPIPE), as it does when rpid is gone. Index lines are 64
+ * bytes apart so the two sides do not share a cache line.
+ */
+struct Ring {
+	char magic[8];           // "sp-ring1"
+	uint64_t size;           // data bytes
+	_Atomic uint32_t closed;
+	_Atomic int32_t pid;     // producer
+	_Atomic int32_t rpid;    // consumer, 0 none yet, -1 left
+	uint8_t pad0[36];
+	_Atomic uint64_t head;   // offset 64
+	_Atomic uint32_t hseq;
+	_Atomic uint32_t rwait;
+	uint8_t pad1[48];
+	_Atomic uint64_t tail;   // offset 128
+	_Atomic uint32_t tseq;
+	_Atomic uint32_t wwait;
+	uint8_t pad2[48];
+};                               // data at offset 192
+
+// open side of ring
+struct RingEnd {
+	struct Ring* r;
+	uint8_t* data;
+	size_t len;
+	char name[256];
+};
+
+// -O ring, closed at exit when error path does not fclose it
+struct RingEnd* ring_out;
+
+// sleep while *w is v, up to ms milliseconds
+long futex_wait(_Atomic uint32_t* w, uint32_t v, int ms) {
+	struct timespec t = { ms / 1000, ms % 1000 * 1000000L };
+	return syscall (SYS_futex, w, FUTEX_WAIT, v, &t, NULL, 0);
+}
+
+// bump *w and wake its sleepers
+void futex_wake(_Atomic uint32_t* w) {
+	atomic_fetch_add (w, 1);
+	syscall (SYS_futex, w, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+// fopencookie write of -O: copy n bytes of b into ring, waiting for space
+ssize_t ring_write(void* c, const char* b, size_t n) {
+	struct Ring* r = ((struct RingEnd*)c)->r;
+	uint8_t* d = ((struct RingEnd*)c)->data;
+	uint64_t h = atomic_load_explicit (&r->head, memory_order_relaxed);
+	for (size_t done = 0; done < n; ) {
+		uint64_t t = atomic_load_explicit (&r->tail, memory_order_acquire);
+		if (h - t == r->size) {
+			uint32_t s = atomic_load (&r->tseq);
+			atomic_store (&r->wwait, 1);
+			int32_t p = atomic_load (&r->rpid);
+			if (atomic_load (&r->tail) == t && p >= 0 && futex_wait (&r->tseq, s, 1000) &&
+					errno == ETIMEDOUT && p && kill (p, 0) && errno == ESRCH)
+				p = -1;
+			atomic_store (&r->wwait, 0);
+			if (p < 0 && atomic_load (&r->tail) == t) {
+				// no one will read it, fail as write to pipe does
+				errno = EPIPE;
+				raise (SIGPIPE);
+				return -1;
+			}
+			continue;
+		}
+		size_t m = n - done < r->size - (h - t) ? n - done : r->size - (h - t);
+		size_t o = h & (r->size - 1);
+		size_t k = m < r->size - o ? m : r->size - o;
+		memcpy (d + o, b + done, k);
+		memcpy (d, b + done + k, m - k);
+		h += m;
+		done += m;
+		atomic_store (&r->head, h);
+		if (atomic_load (&r->rwait)) futex_wake (&r->hseq);
+	}
+	return n;
+}
+
+// fopencookie read of -Q: copy up to n bytes out of ring, waiting for them, 0 at end
+ssize_t ring_read(void* c, char* b, size_t n) {
+	struct Ring* r = ((struct RingEnd*)c)->r;
+	uint8_t* d = ((struct RingEnd*)c)->data;
+	uint64_t t = atomic_load_explicit (&r->tail, memory_order_relaxed);
+	for (;;) {
+		uint64_t h = atomic_load_explicit (&r->head, memory_order_acquire);
+		if (h != t) {
+			size_t m = n < h - t ? n : h - t;
+			size_t o = t & (r->size - 1);
+			size_t k = m < r->size - o ? m : r->size - o;
+			memcpy (b, d + o, k);
+			memcpy (b + k, d, m - k);
+			atomic_store (&r->tail, t + m);
+			if (atomic_load (&r->wwait)) futex_wake (&r->tseq);
+			return m;
+		}
+		// closed is set after last head move, so head read after it is final
+		if (atomic_load (&r->closed)) {
+			if (atomic_load (&r->head) != t) continue;
+			return 0;
+		}
+		uint32_t s = atomic_load (&r->hseq);
+		atomic_store (&r->rwait, 1);
+		if (atomic_load (&r->head) == t && !atomic_load (&r->closed) &&
+				futex_wait (&r->hseq, s, 1000) && errno == ETIMEDOUT &&
+				kill (atomic_load (&r->pid), 0) && errno == ESRCH)
+			atomic_store (&r->closed, 1);
+		atomic_store (&r->rwait, 0);
+	}
+}
+
+// mark ring closed and wake consumer
+void ring_end(struct RingEnd* e) {
+	atomic_store (&e->r->closed, 1);
+	futex_wake (&e->r->hseq);
+}
+
+void ring_exit(void) {
+	if (ring_out == NULL) return;
+	fflush (NULL);
+	ring_end (ring_out);
+}
+
+// fopencookie close of -O and -Q, drained closed ring is removed
+int ring_close(void* c) {
+	struct RingEnd* e = c;
+	if (e == ring_out) {
+		ring_end (e);
+		ring_out = NULL;
+	}
+	else if (atomic_load (&e->r->closed) && atomic_load (&e->r->head) == atomic_load (&e->r->tail))
+		shm_unlink (e->name);
+	else {
+		atomic_store (&e->r->rpid, -1);
+		futex_wake (&e->r->tseq);
+	}
+	munmap (e->r, e->len);
+	free (e);
+	return 0;
+}
+
+/*
+ * Open shm ring NAME as stream, for writing (wr = 1) or reading. Writer
+ * creates it with size data bytes (rounded up to power of 2) or continues
+ * an existing one, reader needs existing one. Returns NULL on error.
+ */
+FILE* ring_open(const char* name, uint64_t size, int wr) {
+	struct RingEnd* e = calloc (1, sizeof(struct RingEnd));
+	if (e == NULL) return NULL;
+	snprintf (e->name, sizeof(e->name), "%s%s", *name == '/' ? "" : "/", name);
+	int fd = shm_open (e->name, wr ? O_RDWR | O_CREAT : O_RDWR, 0600);
+	struct stat st;
+	if (fd < 0 || fstat (fd, &st)) {
+		if (fd >= 0) close (fd);
+		free (e);
+		return NULL;
+	}
+	uint64_t s = 4096;
+	while (s < size && s < (1ull << 62)) s <<= 1;
+	int fresh = wr && st.st_size == 0;
+	e->len = fresh ? sizeof(struct Ring) + s : (size_t)st.st_size;
+	if (fresh && ftruncate (fd, e->len)) e->len = 0;
+	e->r = e->len >= sizeof(struct Ring) ? mmap (NULL, e->len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close (fd);
+	if (e->r == MAP_FAILED) {
+		free (e);
+		return NULL;
+	}
+	e->data = (uint8_t*)(e->r + 1);
+	if (fresh) {
+		e->r->size = s;
+		memcpy (e->r->magic, "sp-ring1", 8);
+	}
+	if (memcmp (e->r->magic, "sp-ring1", 8) || e->r->size & (e->r->size - 1) || e->len != sizeof(struct Ring) + e->r->size) {
+		munmap (e->r, e->len);
+		free (e);
+		return NULL;
+	}
+	if (wr) {
+		// consumer that left an earlier stream may come again
+		int32_t p = -1;
+		atomic_compare_exchange_strong (&e->r->rpid, &p, 0);
+		atomic_store (&e->r->pid, getpid ());
+		atomic_store (&e->r->closed, 0);
+		ring_out = e;
+	}
+	else
+		atomic_store (&e->r->rpid, getpid ());
+	cookie_io_functions_t io = { wr ? NULL : ring_read, wr ? ring_write : NULL, NULL, ring_close };
+	FILE* f = fopencookie (e, wr ? "w" : "r", io);
+	if (f == NULL) {
+		ring_out = NULL;
+		munmap (e->r, e->len);
+		free (e);
+		return NULL;
+	}
+	setvbuf (f, NULL, _IOFBF, 1 << 16);
+	return f;
+}
+#endif
+
+// next value of splitmix64 generator with state *s
+uint64_t rnd(uint64_t* s) {
+	return mix64 (*s += 0x9e3779b97f4a7c15ull);
+}
+
+// uniform value below n from generator state *s
+uint64_t rnd_below(uint64_t* s, uint64_t n) {
+	return (u128)rnd (s) * n >> 64;
+}
+
+/*
+ * Pick k distinct numbers below n (k < n) into r in increasing order, by
+ * Floyd's algorithm with an open addressing set, so work depends on k only.
+ * Returns 0 or -1 on allocation error.
+ */
+int pick(uint64_t* r, uint64_t k, uint64_t n, uint64_t* seed) {
+	int b = 1;
+	while (((uint64_t)1 << b) < k * 2) b++;
+	uint64_t mask = ((uint64_t)1 << b) - 1;
+	uint64_t* set = calloc (mask + 1, sizeof(uint64_t)); // number + 1, 0 empty
+	if (set == NULL) return -1;
+	for (uint64_t j = n - k, c = 0; j < n; j++) {
+		uint64_t t = rnd_below (seed, j + 1), h;
+		for (h = (t * 0x9e3779b97f4a7c15ull) >> (64 - b); set[h] && set[h] != t + 1; h = (h + 1) & mask);
+		if (set[h]) {
+			// t already taken, j is new as it was never in range before
+			t = j;
+			for (h = (t * 0x9e3779b97f4a7c15ull) >> (64 - b); set[h]; h = (h + 1) & mask);
+		}
+		set[h] = t + 1;
+		r[c++] = t;
+	}
+	free (set);
+	qsort (r, k, sizeof(uint64_t), u64_cmp);
+	return 0;
+}
+
+/*
+ * Print a sample of records of fmts in in as "[record] name: value": every
+ * every-th record, or when every is 0, k records picked uniformly at random
+ * from generator seed. Fixed size records of a regular file are reached
+ * directly in its mapping, so only sampled records are read. Other input is
+ * read through, the random sample is then kept in a reservoir of k records.
+ * Records are printed in input order. With ck (every only) checkpoints are
+ * written and input is taken to start at record ck->rec. Returns 0, -1 on
+ * allocation error, -2 on partial or invalid record or -4 when checkpoint
+ * can not be written.
+ */
+int sample(FILE* in, FILE* out, struct Fmt* fmts, uint64_t every, uint64_t k, uint64_t seed, struct Ckpt* ck, uint32_t max_name_size) {
+	uint32_t nf = 0;
+	for (struct Fmt* i = fmts; i; i = i->next) nf++;
+	size_t vmax, rs = rec_size (fmts), len = 0;
+	rec_max (fmts, &vmax);
+	uint8_t* v = malloc (vmax);
+	const uint8_t** at = malloc (nf * sizeof(uint8_t*));
+	uint8_t* m = rs ? map_file (in, &len) : NULL;
+	int err = v == NULL || at == NULL ? -1 : 0;
+
+	if (m && !err) {
+		uint64_t n = len / rs;
+		if (len) madvise (m, len, MADV_RANDOM);
+		if (every) {
+			for (uint64_t r = ck ? ck->rec : 0; r < n && !err; r += every) {
+				rec_fields (fmts, m + r * rs, at);
+				rec_print (out, fmts, m + r * rs, rs, at, v, NULL, r, max_name_size);
+				if (ck && r + every - ck->rec >= ck->every && ckpt_save (ck, out, (r + every) * rs, r + every)) err = -4;
+			}
+		} else {
+			if (k > n) k = n;
+			uint64_t* r = malloc (k * sizeof(uint64_t) + 1);
+			if (r == NULL || (k < n ? pick (r, k, n, &seed) : 0)) err = -1;
+			for (uint64_t j = 0; !err && j < k; j++) {
+				uint64_t x = k < n ? r[j] : j;
+				rec_fields (fmts, m + x * rs, at);
+				rec_print (out, fmts, m + x * rs, rs, at, v, NULL, x, max_name_size);
+			}
+			free (r);
+		}
+		if (!err && len % rs) err = -2;
+		unmap_file (m, len);
+		free (v);
+		free (at);
+		return err;
+	}
+
+	// reservoir of k records, slot j holds record number no[j] of l[j] bytes
+	uint64_t* no = every ? NULL : malloc (k * sizeof(uint64_t));
+	uint8_t** d = every ? NULL : calloc (k, sizeof(uint8_t*));
+	size_t* l = every ? NULL : malloc (k * sizeof(size_t));
+	if (!every && (no == NULL || d == NULL || l == NULL)) err = -1;
+	size_t cap = 256, n = 0;
+	uint8_t* buf = malloc (cap);
+	if (buf == NULL) err = -1;
+	uint64_t r = ck ? ck->rec : 0;
+	uint64_t pos = ck ? ck->in : 0;
+	for (; !err; r++) {
+		size_t rl = rec_read (in, fmts, &buf, &cap, &n);
+		if (rl == 0) {
+			if (n) err = -2;
+			break;
+		}
+		if (rl == (size_t)-1) {
+			err = -2;
+			break;
+		}
+		if (every) {
+			pos += rl;
+			if (r % every) continue;
+			rec_fields (fmts, buf, at);
+			rec_print (out, fmts, buf, rl, at, v, NULL, r, max_name_size);
+			if (ck && r + 1 - ck->rec >= ck->every && ckpt_save (ck, out, pos, r + 1)) err = -4;
+			continue;
+		}
+		uint64_t j = r < k ? r : rnd_below (&seed, r + 1);
+		if (j >= k) continue;
+		uint8_t* t = realloc (d[j], rl);
+		if (t == NULL) {
+			err = -1;
+			break;
+		}
+		memcpy (t, buf, rl);
+		d[j] = t;
+		l[j] = rl;
+		no[j] = r;
+	}
+
+	// slots are filled in input order till first replacement, sort them back
+	if (!every && !err) {
+		uint64_t c = r < k ? r : k;
+		uint64_t* o = malloc (c * 2 * sizeof(uint64_t) + 1);
+		if (o == NULL) err = -1;
+		for (uint64_t j = 0; o && j < c; j++) {
+			o[j * 2] = no[j];
+			o[j * 2 + 1] = j;
+		}
+		if (o) qsort (o, c, 2 * sizeof(uint64_t), u64_cmp);
+		for (uint64_t j = 0; o && j < c; j++) {
+			uint64_t x = o[j * 2 + 1];
+			rec_fields (fmts, d[x], at);
+			rec_print (out, fmts, d[x], l[x], at, v, NULL, no[x], max_name_size);
+		}
+		free (o);
+	}
+	for (uint64_t j = 0; d && j < k; j++) free (d[j]);
+	free (d);
+	free (l);
+	free (no);
+	free (buf);
+	free (v);
+	free (at);
+	return err;
+}
+
+enum { ERR_OPT_LIST=1, ERR_UNK_OPT, ERR_MISS_FMT, ERR_MISS_FMT_CHR,
+	ERR_ARR_FMT, ERR_NAME_OPT, ERR_NAME_TOO_FEW, ERR_NAME_TOO_MUCH,
+	ERR_PRINT_OPT, ERR_PRINT_TOO_FEW, ERR_PRINT_INV_FMT,
+	ERR_PRINT_TOO_MUCH, ERR_OPEN_IN_FILE, ERR_OPEN_OUT_FILE, 
+	ERR_PASCAL_STR_LEN, ERR_IN_NAME_ALLOW, ERR_VALS_COUNT, 
+	ERR_ALLOC, ERR_READ_IN, ERR_INV_FMT_CHR, ERR_STR_LEN_LIMIT, 
+	ERR_GEN_NAME, ERR_VAR_FMT, ERR_MAP_FILE, ERR_SORT_KEY, ERR_TMP_FILE,
+	ERR_TRANS_FMT, ERR_RANGE, ERR_BIT_FMT, ERR_CRC_FMT, ERR_CRC,
+	ERR_MARKER, ERR_UNION, ERR_SCHEMA, ERR_DICT, ERR_INPUT, ERR_RING,
+	ERR_CKPT, ERR_RECORD,
+};
+
+
+// parse fmt string into list of fields
+int parse_fmt(char* fmt, struct Fmt** fmts) {
+	for (struct Fmt* prev = NULL; fmt && *fmt; ) {
+		struct Fmt* i = new(fmts);
+		if (i == NULL) {
+			fprintf (stderr, "ERROR: Could not allocate memory!\n");
+			return ERR_ALLOC;
+		}
+
+		// parse endian indicator
+		if (strchr ("<>@", *fmt))
+			i->endian = *fmt++;
+
+		// parse format
+		if (!*fmt) {
+			fprintf (stderr, "ERROR: missing fmt char!\n");
+			return ERR_MISS_FMT_CHR;
+		}
+		if (strchr ("xcbBhHiIqQfdsptTvzC", *fmt))
+			i->format = *fmt++;
+		else {
+			fprintf (stderr, "ERROR: invalid fmt char '%c'\n", *fmt);
+			return ERR_INV_FMT_CHR;
+		}
+
+		// set default print format
+		switch (i->format) {
+			case 'x': i->print = ""; break;
+			case 'c': i->print = "%c"; break;
+			case 'b': 
+			case 'B': 
+			case 'h': 
+			case 'H': 
+			case 'i': 
+			case 'I': 
+			case 'C': i->print = "%x"; break;
+			case 'q': 
+			case 'Q': 
+			case 't': 
+			case 'T': 
+			case 'v': 
+			case 'z': i->print = "%llx"; break;
+			case 'f': i->print = "%f"; break;
+			case 'd': i->print = "%lf"; break;
+			case 's': 
+			case 'p': i->print = "%s"; break;
+		}
+
+		// parse bit width, bit fields following each other share bytes
+		if (i->format == 't' || i->format == 'T') {
+			char *t = NULL;
+			unsigned long w = *fmt == '{' ? strtoul (fmt + 1, &t, 0) : 0;
+			if (t == NULL || *t != '}' || w < 1 || w > 64) {
+				fprintf (stderr, "ERROR: bit field needs width \"{1..64}\"\n");
+				return ERR_BIT_FMT;
+			}
+			i->bits = w;
+			fmt = t+1;
+		}
+
+		// checksum covers all record bytes before it, or last "{N}" of them
+		if (i->format == 'C' && *fmt == '{') {
+			char *t = NULL;
+			unsigned long n = strtoul (fmt + 1, &t, 0);
+			if (t == NULL || *t != '}' || n < 1 || n > UINT32_MAX) {
+				fprintf (stderr, "ERROR: invalid checksum span, use \"{N}\"\n");
+				return ERR_CRC_FMT;
+			}
+			i->span = n;
+			fmt = t+1;
+		}
+
+		// parse array notaton
+		if (*fmt == '['){
+			fmt++;
+			char *t = NULL;
+			i->count = strtoull (fmt, &t, 0);
+			if (t && *t != ']') {
+				fprintf (stderr, "ERROR: invalid array notation format!\n");
+				return ERR_ARR_FMT;
+			}
+			// only fixed size elements can be streamed past ARR_MAX
+			if (i->count < 1 || i->count > UINT64_MAX / 8 || (i->count > ARR_MAX && !fmt_size (i->format))) {
+				fprintf (stderr, "ERROR: array size '%llu' invalid\n", (unsigned long long)i->count);
+				return ERR_ARR_FMT;
+			}
+			fmt = t+1;
+		}
+		if (i->format == 'C' && i->count != 1) {
+			fprintf (stderr, "ERROR: checksum field can not be an array\n");
+			return ERR_CRC_FMT;
+		}
+
+		if (i->bits && prev && prev->bits) {
+			if ((i->endian == '@' ? HOST_ENDIAN : i->endian) != (prev->endian == '@' ? HOST_ENDIAN : prev->endian)) {
+				fprintf (stderr, "ERROR: bit fields following each other need same bit order\n");
+				return ERR_BIT_FMT;
+			}
+			i->bit = prev->bit + prev->bits * prev->count;
+		}
+		prev = i;
+	}
+	if (span_check (*fmts)) {
+		fprintf (stderr, "ERROR: checksum span is longer than fields before it\n");
+		return ERR_CRC_FMT;
+	}
+	return 0;
+}
+
+// assign comma separated names to fields (except x), tracks longest name
+int parse_names(struct Fmt* fmts, char* names, uint32_t* max_name_size) {
+	for (struct Fmt* i = fmts; i; i = i->next) {
+		if (i->format == 'x') continue;
+
+		if (names == NULL) {
+			fprintf (stderr, "ERROR: too few names\n");
+			return ERR_NAME_TOO_FEW;
+		}
+		i->name = names;
+
+		char *t = strchr (names, ',');
+		if (t) {
+			*t = '\0';
+			names = t + 1;
+		} else {
+			names = NULL;
+		}
+
+		size_t l = strlen (i->name);
+		if (*max_name_size < l) {
+			*max_name_size = l;
+		}
+
+
+	}
+	if (names != NULL) {
+		fprintf (stderr, "ERROR: too much names\n");
+		return ERR_NAME_TOO_MUCH;
+
+	}
+	return 0;
+}
+
+// give field i of fmts dictionary file path, loaded once for all fields naming it
+int dict_use(struct Fmt* fmts, struct Fmt* i, const char* path) {
+	for (struct Fmt* j = fmts; j != i; j = j->next) {
+		if (j->dict && strcmp (j->dict->path, path) == 0) {
+			i->dict = j->dict;
+			return 0;
+		}
+	}
+	uint64_t ln = 0;
+	switch (dict_load (path, &i->dict, &ln)) {
+		case -1:
+			fprintf (stderr, "ERROR: could not read dictionary '%s'\n", path);
+			return ERR_DICT;
+		case -2:
+			fprintf (stderr, "ERROR: invalid dictionary line %llu in '%s', use \"VALUE NAME\"\n", (unsigned long long)ln, path);
+			return ERR_DICT;
+		case -3:
+			fprintf (stderr, "ERROR: value given twice in dictionary '%s'\n", path);
+			return ERR_DICT;
+		case -4:
+			fprintf (stderr, "ERROR: no perfect hash found for dictionary '%s'\n", path);
+			return ERR_DICT;
+	}
+	return 0;
+}
+
+// validate and set print format chars for fields (except x)
+int parse_print(struct Fmt* fmts, char* print) {
+	// -p over print of schema replaces it whole
+	for (struct Fmt* i = fmts; i; i = i->next) {
+		for (struct Fmt* z = i->next; i->dict && z; z = z->next)
+			if (z->dict == i->dict) z->dict = NULL;
+		dict_free (i->dict);
+		i->dict = NULL;
+		i->ts = 0;
+		i->tz = 0;
+		i->shortest = 0;
+	}
+	for (struct Fmt* i = fmts; i; i = i->next) {
+		if (i->format == 'x') continue;
+
+		if(*print == 0) {
+			fprintf (stderr, "ERROR: too few print formats\n");
+			return ERR_PRINT_TOO_FEW;
+		}
+
+		// validate format for fmt 
+		switch (i->format) {
+			case 'c':
+				switch (*print) {
+					case 'c': i->print = "%c"; break;
+					default:
+						fprintf (stderr, "ERROR: invalid print format '%c' for '%c' fmt\n", i->format, *print);
+						return ERR_PRINT_INV_FMT;
+				}
+				break;
+			case 'b':
+			case 'h':
+			case 'i':
+			case 'q':
+			case 't':
+			case 'z':
+				switch (*print) {
+					case 'd': i->print = strchr ("qtz", i->format) ? "%lli" : "%i"; break;
+					case 'x': i->print = strchr ("qtz", i->format) ? "%llx" : "%x"; break;
+					case 'o': i->print = strchr ("qtz", i->format) ? "%llo" : "%o"; break;
+					case 'b': i->print = strchr ("qtz", i->format) ? "%llb" : "%b"; break;
+					case 'S':
+					case 'M':
+					case 'U':
+					case 'N':
+						// number print of times out of date range
+						i->print = strchr ("qtz", i->format) ? "%lli" : "%i";
+						i->ts = *print;
+						break;
+					default: {
+						fprintf (stderr, "ERROR: invalid print format '%c' for '%c' fmt\n", i->format, *print);
+						return ERR_PRINT_INV_FMT;
+					}
+
+				}
+				break;
+			case 'B':
+			case 'H':
+			case 'I':
+			case 'Q':
+			case 'T':
+			case 'v':
+			case 'C':
+				switch (*print) {
+					case 'd': i->print = strchr ("QTv", i->format) ? "%llu" : "%u"; break;
+					case 'x': i->print = strchr ("QTv", i->format) ? "%llx" : "%x"; break;
+					case 'o': i->print = strchr ("QTv", i->format) ? "%llo" : "%o"; break;
+					case 'b': i->print = strchr ("QTv", i->format) ? "%llb" : "%b"; break;
+					case 'S':
+					case 'M':
+					case 'U':
+					case 'N':
+						i->print = strchr ("QTv", i->format) ? "%llu" : "%u";
+						i->ts = *print;
+						break;
+					default: 
+						fprintf (stderr, "ERROR: invalid print format '%c' for '%c' fmt\n", i->format, *print);
+						return ERR_PRINT_INV_FMT;
+					
+				}
+				break;
+			case 'f':
+				switch (*print) {
+					case 'f': i->print = "%f"; break;
+					case 'e': i->print = "%e"; break;
+					case 'r': i->print = "%.9g"; i->shortest = 1; break;
+					default:
+						fprintf (stderr, "ERROR: invalid print format '%c' for '%c' fmt\n", i->format, *print);
+						return ERR_PRINT_INV_FMT;
+				}
+				break;
+			case 'd':
+				switch (*print) {
+					case 'f': i->print = "%lf"; break;
+					case 'e': i->print = "%le"; break;
+					case 'r': i->print = "%.17g"; i->shortest = 1; break;
+					default:
+						fprintf (stderr, "ERROR: invalid print format '%c' for '%c' fmt\n", i->format, *print);
+						return ERR_PRINT_INV_FMT;
+				}
+				break;
+			case 's':
+			case 'p':
+				switch (*print) {
+					case 's': i->print = "%s"; break;
+					default:
+						fprintf (stderr, "ERROR: invalid print format '%c' for '%c' fmt\n", i->format, *print);
+						return ERR_PRINT_INV_FMT;
+				}
+				break;
+
+		}
+
+		// "{+HH:MM}" after timestamp print format is its offset from UTC
+		if (i->ts && print[1] == '{') {
+			char* z = print + 2;
+			if (strlen (z) < 7 || !strchr ("+-", z[0]) || z[3] != ':' || z[6] != '}' ||
+					!strchr ("01", z[1]) || !strchr ("0123456789", z[2]) || !strchr ("012345", z[4]) || !strchr ("0123456789", z[5]) ||
+					((z[1] - '0') * 10 + z[2] - '0') * 3600 + ((z[4] - '0') * 10 + z[5] - '0') * 60 > TZ_MAX) {
+				fprintf (stderr, "ERROR: invalid timestamp offset, use \"{+HH:MM}\" up to 14:00\n");
+				return ERR_PRINT_INV_FMT;
+			}
+			i->tz = ((z[1] - '0') * 10 + z[2] - '0') * 3600 + ((z[4] - '0') * 10 + z[5] - '0') * 60;
+			if (z[0] == '-') i->tz = -i->tz;
+			print = z + 6;
+		}
+
+		// "{FILE}" after integer print format prints names of values from dictionary FILE
+		else if (print[1] == '{' && strchr ("bhiqtzBHIQTvC", i->format)) {
+			char* e = strchr (print + 2, '}');
+			if (e == NULL) {
+				fprintf (stderr, "ERROR: missing '}' after dictionary file\n");
+				return ERR_DICT;
+			}
+			*e = '\0';
+			int err = dict_use (fmts, i, print + 2);
+			if (err) return err;
+			print = e;
+		}
+
+		print++;
+
+	}
+
+	if (*print != 0) {
+		fprintf (stderr, "ERROR: too much print formats char.");
+		return ERR_PRINT_TOO_MUCH;
+	}
+	return 0;
+}
+
+// 64 bit FNV-1a of n bytes at d continuing from h
+uint64_t fnv(uint64_t h, const void* d, size_t n) {
+	const uint8_t* p = d;
+	while (n--) h = (h ^ *p++) * 0x100000001b3ull;
+	return h;
+}
+
+// compiled schema cache file: head, nf fields, strs bytes of nul terminated strings
+struct SpcHead {
+	char magic[4];  // "spc5"
+	uint32_t nf;
+	uint32_t max_name_size;
+	uint32_t strs;
+	uint64_t key;   // hash of schema text
+};
+struct SpcField {
+	uint64_t count;
+	uint32_t bit;
+	uint32_t span;
+	uint32_t name;  // offset in strings + 1, 0 when unnamed
+	uint32_t print; // offset in strings
+	uint32_t dict;  // offset of dictionary file in strings + 1, 0 when none
+	int32_t tz;
+	char endian;
+	char format;
+	uint8_t bits;
+	char ts;
+	char shortest;
+};
+
+// cache file path of schema key in o, 0 when there is no cache directory
+int spc_path(char* o, size_t n, uint64_t key) {
+	const char* x = getenv ("XDG_CACHE_HOME");
+	const char* h = getenv ("HOME");
+	int l;
+	if (x && *x) {
+		mkdir (x, 0755);
+		l = snprintf (o, n, "%s/sp", x);
+	}
+	else if (h && *h) {
+		snprintf (o, n, "%s/.cache", h);
+		mkdir (o, 0755);
+		l = snprintf (o, n, "%s/.cache/sp", h);
+	}
+	else return 0;
+	mkdir (o, 0755);
+	return snprintf (o + l, n - l, "/%016llx.spc", (unsigned long long)key) < (int)(n - l);
+}
+
+// write compiled fmts into cache file path, errors only mean there is no cache
+void spc_save(const char* path, struct Fmt* fmts, uint32_t max_name_size, uint64_t key) {
+	struct SpcHead h = { "spc", 0, max_name_size, 0, key };
+	h.magic[3] = '5';
+	for (struct Fmt* i = fmts; i; i = i->next) {
+		h.nf++;
+		h.strs += strlen (i->print) + 1 + (i->name ? strlen (i->name) + 1 : 0);
+		h.strs += i->dict ? strlen (i->dict->path) + 1 : 0;
+	}
+	size_t size = sizeof(h) + h.nf * sizeof(struct SpcField) + h.strs;
+	uint8_t* b = calloc (1, size);
+	if (b == NULL) return;
+	memcpy (b, &h, sizeof(h));
+	struct SpcField* f = (struct SpcField*)(b + sizeof(h));
+	char* s = (char*)(f + h.nf);
+	uint32_t o = 0;
+	for (struct Fmt* i = fmts; i; i = i->next, f++) {
+		*f = (struct SpcField){ i->count, i->bit, i->span, 0, o, 0, i->tz, i->endian, i->format, i->bits, i->ts, i->shortest };
+		o += sprintf (s + o, "%s", i->print) + 1;
+		if (i->name) {
+			f->name = o + 1;
+			o += sprintf (s + o, "%s", i->name) + 1;
+		}
+		if (i->dict) {
+			f->dict = o + 1;
+			o += sprintf (s + o, "%s", i->dict->path) + 1;
+		}
+	}
+
+	// written aside and renamed, readers never see half a file
+	char tmp[4096];
+	snprintf (tmp, sizeof(tmp), "%s.tmp", path);
+	FILE* c = fopen (tmp, "wb");
+	if (c) {
+		int ok = fwrite (b, size, 1, c) == 1;
+		ok &= fclose (c) == 0;
+		if (!ok || rename (tmp, path)) remove (tmp);
 	}
+	free (b);
 }
 
+// build fmts from mapped cache file path, 0 on success, -1 when there is no
+// valid cache, ERR_DICT when a dictionary of it fails to load
+/*
+ * Whether field i following prev read from cache is one parse_fmt and
+ * parse_print can make: its print string is passed to printf and its
+ * count, bits and offsets size buffers, so a corrupt cache must not get by.
+ */
+int spc_field_ok(struct Fmt* i, struct Fmt* prev) {
+	const char* p = i->print;
+	int ok;
+	switch (i->format) {
+		case 'x': ok = !*p; break;
+		case 'c': ok = !strcmp (p, "%c"); break;
+		case 'f': ok = !strcmp (p, "%f") || !strcmp (p, "%e") || !strcmp (p, "%.9g"); break;
+		case 'd': ok = !strcmp (p, "%lf") || !strcmp (p, "%le") || !strcmp (p, "%.17g"); break;
+		case 's':
+		case 'p': ok = !strcmp (p, "%s"); break;
+		default: {
+			// one word of integer conversions of field width
+			const char* w = strchr ("bBhHiIC", i->format) ? " %i %u %x %o %b " : " %lli %llu %llx %llo %llb ";
+			size_t l = strlen (p);
+			const char* at = l && !strchr (p, ' ') ? strstr (w, p) : NULL;
+			ok = at && at[-1] == ' ' && at[l] == ' ';
+		}
+	}
+	int bf = i->format == 't' || i->format == 'T';
+	int run = bf && prev && prev->bits;
+	uint32_t bit = run ? prev->bit + prev->bits * prev->count : 0;
+	return ok && i->endian && strchr ("<>@", i->endian) &&
+		i->count >= 1 && i->count <= UINT64_MAX / 8 && (i->count <= ARR_MAX || fmt_size (i->format)) &&
+		(i->format != 'C' || i->count == 1) && (i->format == 'C' || !i->span) &&
+		(bf ? i->bits >= 1 && i->bits <= 64 : !i->bits) && i->bit == bit &&
+		(!run || (i->endian == '@' ? HOST_ENDIAN : i->endian) == (prev->endian == '@' ? HOST_ENDIAN : prev->endian)) &&
+		(!i->ts || (strchr ("SMUN", i->ts) && strchr ("bBhHiIqQtTvzC", i->format))) &&
+		(i->ts || !i->tz) && i->tz % 60 == 0 && i->tz >= -TZ_MAX && i->tz <= TZ_MAX &&
+		(!i->shortest || (i->shortest == 1 && strchr ("fd", i->format)));
+}
 
-void endian(char e, void* d, int l) {
-	uint8_t* x = (uint8_t*)d;
-	if (l&1) return;
-        if (x == NULL) return;
+int spc_load(const char* path, struct Fmt** fmts, uint32_t* max_name_size, uint64_t key) {
+	FILE* c = fopen (path, "rb");
+	if (c == NULL) return -1;
+	size_t len = 0;
+	uint8_t* m = map_file (c, &len);
+	fclose (c);
+	if (m == NULL) return -1;
 
-	// only for LE X86
-	if (e == '@' || e == '<') return;
-	if (e == '>') {
-		uint8_t* z = (uint8_t*)d + l - 1;
-		l >>= 1; // div 2
-		for (uint8_t y; l; l--) {
-			y = *z;
-			*z = *x;
-			*x = y;
-			x++;
-			z--;
+	struct SpcHead h;
+	if (len >= sizeof(h)) memcpy (&h, m, sizeof(h));
+	if (len < sizeof(h) || memcmp (h.magic, "spc5", 4) || h.key != key ||
+			len != sizeof(h) + (size_t)h.nf * sizeof(struct SpcField) + h.strs || h.strs == 0 || m[len - 1]) {
+		unmap_file (m, len);
+		return -1;
+	}
+	const struct SpcField* f = (const struct SpcField*)(m + sizeof(h));
+	char* s = (char*)(f + h.nf);
+	struct Fmt** t = fmts;
+	struct Fmt* prev = NULL;
+	for (uint32_t j = 0; j < h.nf; j++, f++) {
+		struct Fmt* i = calloc (1, sizeof(struct Fmt));
+		if (i == NULL || f->print >= h.strs || f->name > h.strs || f->dict > h.strs || !strchr ("xcbBhHiIqQfdsptTvzC", f->format) || !f->format) {
+			free (i);
+			delete (fmts);
+			unmap_file (m, len);
+			return -1;
+		}
+		*i = (struct Fmt){ f->endian, f->format, s + f->print, f->count, NULL, 0, f->name ? s + f->name - 1 : NULL, f->bits, f->bit, f->span, NULL, f->ts, f->shortest, f->tz, NULL };
+		*t = i;
+		t = &i->next;
+		if (!spc_field_ok (i, prev)) {
+			delete (fmts);
+			unmap_file (m, len);
+			return -1;
+		}
+		prev = i;
+		// dictionaries are read fresh, their files may change
+		if (f->dict && dict_use (*fmts, i, s + f->dict - 1)) {
+			delete (fmts);
+			unmap_file (m, len);
+			return ERR_DICT;
 		}
 	}
-
-	//TODO: for BE arch
+	uint32_t mn = 0;
+	for (struct Fmt* i = *fmts; i; i = i->next)
+		if (i->name && strlen (i->name) > mn) mn = strlen (i->name);
+	if (span_check (*fmts) || h.max_name_size != mn) {
+		delete (fmts);
+		unmap_file (m, len);
+		return -1;
+	}
+	// mapping stays for names and prints
+	*max_name_size = h.max_name_size;
+	return 0;
 }
 
+// append n bytes of a to string *s of length *l, with sep in between when both are not empty
+int str_add(char** s, size_t* l, const char* a, size_t n, char sep) {
+	char* x = realloc (*s, *l + n + 2);
+	if (x == NULL) return -1;
+	if (sep && *l && n) x[(*l)++] = sep;
+	memcpy (x + *l, a, n);
+	*l += n;
+	x[*l] = '\0';
+	*s = x;
+	return 0;
+}
 
-struct Fmt {
-	char endian;
-	char format;
-	char* print;
-	uint32_t count;
-	void* data;
-	uint32_t size;
-	char* name;
-	struct Fmt* next;
-};
-
+/*
+ * Load schema name from file path into fmts. Schema file holds sections
+ *   [name]
+ *   fmt = ...
+ *   names = ...
+ *   print = ...
+ * where repeated keys are joined, # starts a comment line. Schema is
+ * compiled with parse_fmt, parse_names and parse_print once and cached by
+ * hash of its text, later loads map the cache. *fmt_str gets the fmt.
+ */
+int schema_load(const char* path, const char* name, struct Fmt** fmts, uint32_t* max_name_size, char** fmt_str) {
+	FILE* f = fopen (path, "rb");
+	if (f == NULL) {
+		fprintf (stderr, "ERROR: could not open file '%s'\n", path);
+		return ERR_OPEN_IN_FILE;
+	}
+	char* txt = NULL;
+	char b[65536];
+	size_t n = 0;
+	while (!feof (f) && !ferror (f)) {
+		size_t r = fread (b, 1, sizeof(b), f);
+		if (str_add (&txt, &n, b, r, 0)) {
+			fclose (f);
+			free (txt);
+			fprintf (stderr, "ERROR: could not allocate memory\n");
+			return ERR_ALLOC;
+		}
+	}
+	fclose (f);
 
-struct Fmt* new(struct Fmt** head) {
-	if (head == NULL) return NULL;
-	if (*head == NULL) {
-		*head = malloc (sizeof(struct Fmt));
-		if (*head == NULL) return NULL;
-		(*head)->endian = '@';
-		(*head)->format = 0;
-		(*head)->print = "";
-		(*head)->count = 1;
-		(*head)->data = NULL;
-		(*head)->name = NULL;
-		(*head)->next = NULL;
-		return *head;
-	} else {
-		for (struct Fmt* x = *head; x; x = x->next) {
-			if (x->next == NULL) {
-				return new (&(x->next));
-			}	
+	// collect keys of section, its text is the cache key
+	char* fmt = NULL;
+	char* names = NULL;
+	char* print = NULL;
+	size_t fl = 0, nl = 0, pl = 0, ln = 0;
+	int in = 0, found = 0, err = 0;
+	uint64_t key = fnv (fnv (0xcbf29ce484222325ull, "spc5", 4), name, strlen (name) + 1);
+	for (char* s = txt; s && *s && !err; ) {
+		char* e = strchr (s, '\n');
+		if (e) *e = '\0';
+		char* next = e ? e + 1 : NULL;
+		ln++;
+		while (*s == ' ' || *s == '\t') s++;
+		size_t l = strlen (s);
+		while (l && strchr (" \t\r", s[l - 1])) s[--l] = '\0';
+		if (*s == '[') {
+			in = l > 2 && s[l - 1] == ']' && l - 2 == strlen (name) && strncmp (s + 1, name, l - 2) == 0;
+			found |= in;
+		} else if (in && *s && *s != '#') {
+			key = fnv (key, s, l + 1);
+			char* v = strchr (s, '=');
+			size_t kl = v ? v - s : 0;
+			while (kl && strchr (" \t", s[kl - 1])) kl--;
+			if (v) while (*++v == ' ' || *v == '\t');
+			if (v && kl == 3 && strncmp (s, "fmt", 3) == 0) err = str_add (&fmt, &fl, v, strlen (v), 0);
+			else if (v && kl == 5 && strncmp (s, "names", 5) == 0) err = str_add (&names, &nl, v, strlen (v), ',');
+			else if (v && kl == 5 && strncmp (s, "print", 5) == 0) err = str_add (&print, &pl, v, strlen (v), 0);
+			else {
+				fprintf (stderr, "ERROR: invalid schema line %zu in '%s'\n", ln, path);
+				err = ERR_SCHEMA;
+			}
+			if (err < 0) {
+				fprintf (stderr, "ERROR: could not allocate memory\n");
+				err = ERR_ALLOC;
+			}
 		}
-		//somethting went wrong
-		return NULL;
+		s = next;
+	}
+	free (txt);
+	if (!err && (!found || fmt == NULL)) {
+		fprintf (stderr, "ERROR: schema '%s' with fmt not found in '%s'\n", name, path);
+		err = ERR_SCHEMA;
 	}
-}
 
-void delete(struct Fmt** head) {
-	if (head == NULL) return;
-	for (struct Fmt* x = *head; x;) {
-		struct Fmt* y = x->next;
-		if (x->data)
-			free(x->data);
-		memset (x, 0, sizeof(struct Fmt));
-		free (x);
-		x = y;
+	char cache[4096];
+	int cached = !err && spc_path (cache, sizeof(cache), key);
+	int r = cached ? spc_load (cache, fmts, max_name_size, key) : -1;
+	if (r > 0) err = r;
+	if (!err && r) {
+		// strings stay, fields point into them
+		err = parse_fmt (fmt, fmts);
+		if (!err && names) err = parse_names (*fmts, names, max_name_size);
+		if (!err && print) err = parse_print (*fmts, print);
+		if (!err && cached) spc_save (cache, *fmts, *max_name_size, key);
+		names = print = NULL;
 	}
-	*head = NULL;
+	free (names);
+	free (print);
+	*fmt_str = fmt;
+	return err;
 }
 
-
 const char* banner;
 const char* usage;
+const char* usage_opt;
+const char* usage_io;
+const char* usage_val;
 
 int main(int argc, char* argv[]) {
 
 	if (argc <= 1) {
 		puts (banner);
-		printf (usage, *argv, *argv, *argv);
+		printf (usage, *argv);
+		fputs (usage_opt, stdout);
+		fputs (usage_io, stdout);
+		printf (usage_val, *argv, *argv);
 		return -1;
 	}
 
 	struct Fmt* fmts = NULL;
+	struct Fmt* run = NULL;
+	size_t run_len = 0;
 	uint8_t pad_byte = 0;
 	uint8_t version = 0;
 	uint8_t reverse = 0;
 	uint8_t debug_only = 0;
+	uint8_t hex_only = 0;
+	char* diffn = NULL;
+	uint32_t jobs = 0;
+	char* sort_keys = NULL;
+	uint8_t uniq = 0;
+	size_t mem = 256 << 20;
+	char* trans_fmt = NULL;
+	char* trans_names = NULL;
+	char* marker = NULL;
+	char* len_name = NULL;
+	uint8_t follow_file = 0;
+	char* inputs = NULL;
+	uint64_t every = 0;
+	uint64_t nsample = 0;
+	uint64_t seed = 1;
+	char* union_tab = NULL;
+	char* tag_name = NULL;
+	char* schema_file = NULL;
 	char* names = NULL;
 	uint32_t max_name_size = 0;
 	char* print = NULL;
         char* infn = NULL;
         char* outfn = NULL;
+	char* ring_o = NULL;
+	char* ring_i = NULL;
+	struct Ckpt ckpt = { NULL, 1 << 20, 0, 0, 0, 0 };
+	char* gen_prefix = NULL;
+	char* fmt_str = NULL;
 	FILE* in = stdin;
 	FILE* out = stdout;
-	enum { ERR_OPT_LIST=1, ERR_UNK_OPT, ERR_MISS_FMT, ERR_MISS_FMT_CHR,
-		ERR_ARR_FMT, ERR_NAME_OPT, ERR_NAME_TOO_FEW, ERR_NAME_TOO_MUCH,
-		ERR_PRINT_OPT, ERR_PRINT_TOO_FEW, ERR_PRINT_INV_FMT,
-		ERR_PRINT_TOO_MUCH, ERR_OPEN_IN_FILE, ERR_OPEN_OUT_FILE, 
-		ERR_PASCAL_STR_LEN, ERR_IN_NAME_ALLOW, ERR_VALS_COUNT, 
-		ERR_ALLOC, ERR_READ_IN, ERR_INV_FMT_CHR, ERR_STR_LEN_LIMIT, 
-	};
 
 	// parse opt
 	for (; *argv; ) {
@@ -133,11 +3976,62 @@ int main(int argc, char* argv[]) {
 		else if (*opt == 'r') reverse = 1;
 		else if (*opt == 'v'){ version = 1; break; }
 		else if (*opt == 'd') debug_only = 1;
+		else if (*opt == 'X') { hex_only = 1; reverse = 1; }
+		else if (*opt == 'D') { diffn = *++argv; reverse = 1; }
+		else if (*opt == 'j') {
+			jobs = strtoul (*++argv, NULL, 0);
+			if (jobs < 1) {
+				fprintf (stderr, "ERROR: -j needs number from 1, got '%s'\n", *argv);
+				return ERR_UNK_OPT;
+			}
+		}
+		else if (*opt == 'S') { sort_keys = *++argv; reverse = 1; }
+		else if (*opt == 'u') uniq = 1;
+		else if (*opt == 'M') {
+			char* t = NULL;
+			mem = strtoull (*++argv, &t, 0);
+			if (t && (*t == 'k' || *t == 'K')) mem <<= 10;
+			if (t && (*t == 'm' || *t == 'M')) mem <<= 20;
+			if (t && (*t == 'g' || *t == 'G')) mem <<= 30;
+		}
 		else if (*opt == 'x') pad_byte = (uint8_t)strtoul (*++argv, NULL, 0);
 		else if (*opt == 'n') names = *++argv;
 		else if (*opt == 'p') print = *++argv;
 		else if (*opt == 'i') infn = *++argv;
 		else if (*opt == 'o') outfn = *++argv;
+		else if (*opt == 'O') ring_o = *++argv;
+		else if (*opt == 'Q') { ring_i = *++argv; reverse = 1; }
+		else if (*opt == 'G') gen_prefix = *++argv;
+		else if (*opt == 'T') { trans_fmt = *++argv; reverse = 1; }
+		else if (*opt == 'N') trans_names = *++argv;
+		else if (*opt == 'm') { marker = *++argv; reverse = 1; }
+		else if (*opt == 'l') len_name = *++argv;
+		else if (*opt == 'F') { follow_file = 1; reverse = 1; }
+		else if (*opt == 'U') { union_tab = *++argv; reverse = 1; }
+		else if (*opt == 'k') tag_name = *++argv;
+		else if (*opt == 'f') schema_file = *++argv;
+		else if (*opt == 'I') { inputs = *++argv; reverse = 1; }
+		else if (*opt == 'e' || *opt == 'R') {
+			char* t = NULL;
+			uint64_t n = strtoull (*++argv, &t, 0);
+			if (n < 1 || *t) {
+				fprintf (stderr, "ERROR: -%c needs number from 1, got '%s'\n", *opt, *argv);
+				return ERR_UNK_OPT;
+			}
+			if (*opt == 'e') every = n;
+			else nsample = n;
+			reverse = 1;
+		}
+		else if (*opt == 's') seed = strtoull (*++argv, NULL, 0);
+		else if (*opt == 'c') {
+			// records between checkpoints after last ':'
+			char* t = strrchr (*++argv, ':');
+			char* e = NULL;
+			uint64_t n = t ? strtoull (t + 1, &e, 0) : 0;
+			if (n && !*e) *t = '\0';
+			if (n && !*e) ckpt.every = n;
+			ckpt.path = *argv;
+		}
 		else {
 			fprintf (stderr, "ERROR: unknown parameter '%c'\n", *opt);
 			return ERR_UNK_OPT;
@@ -155,245 +4049,723 @@ int main(int argc, char* argv[]) {
 		fprintf (stderr, "ERROR: missing fmt!\n");
 		return ERR_MISS_FMT;
 	}
-	for (char* fmt = *argv++; fmt && *fmt; ) {
-		struct Fmt* i = new(&fmts);
-		if (i == NULL) {
-			fprintf (stderr, "ERROR: Could not allocate memory!\n");
-			delete (&fmts);
-			return ERR_ALLOC;
-		}
+	fmt_str = *argv;
+	int err = schema_file ? schema_load (schema_file, *argv++, &fmts, &max_name_size, &fmt_str) : parse_fmt (*argv++, &fmts);
+	if (err) {
+		delete (&fmts);
+		return err;
+	}
 
-		// parse endian indicator
-		if (strchr ("<>@", *fmt))
-			i->endian = *fmt++;
+	// key of checkpoint from everything shaping the output, before parse of
+	// names and print cuts them. plain -r checkpoints as -e 1 of all records
+	if (ckpt.path) {
+		if (reverse && !(gen_prefix || hex_only || diffn || sort_keys || trans_fmt || marker || union_tab ||
+				follow_file || inputs || every || nsample || debug_only))
+			every = 1;
+		const char* kv[] = { fmt_str, trans_fmt, trans_names, names, print };
+		ckpt.key = fnv (0xcbf29ce484222325ull, &every, sizeof(every));
+		for (uint32_t j = 0; j < sizeof(kv) / sizeof(*kv); j++)
+			ckpt.key = kv[j] ? fnv (ckpt.key, kv[j], strlen (kv[j]) + 1) : fnv (ckpt.key, "\1", 1);
+	}
 
-		// parse format
-		if (!*fmt) {
-			fprintf (stderr, "ERROR: missing fmt char!\n");
+	// parse names parameter
+	if (names && reverse == 0 && gen_prefix == NULL) {
+		fprintf (stderr, "ERROR: -n allow only with -r");
+		delete (&fmts);
+		return ERR_NAME_OPT;
+	}
+	if (names && (reverse == 1 || gen_prefix)) {
+		err = parse_names (fmts, names, &max_name_size);
+		if (err) {
 			delete (&fmts);
-			return ERR_MISS_FMT_CHR;
+			return err;
 		}
-		if (strchr ("xcbBhHiIqQfdsp", *fmt))
-			i->format = *fmt++;
-		else {
-			fprintf (stderr, "ERROR: invalid fmt char '%c'\n", *fmt);
+	}
+
+	// parse print
+	if (print && reverse == 0 && gen_prefix == NULL) {
+		fprintf (stderr, "ERROR: -p allowed only with -r\n");
+		delete (&fmts);
+		return ERR_PRINT_OPT;
+	}
+	if (print && (reverse == 1 || gen_prefix)) {
+		err = parse_print (fmts, print);
+		if (err) {
 			delete (&fmts);
-			return ERR_INV_FMT_CHR;
+			return err;
 		}
+	}
+	
 
-		// set default print format
-		switch (i->format) {
-			case 'x': i->print = ""; break;
-			case 'c': i->print = "%c"; break;
-			case 'b': 
-			case 'B': 
-			case 'h': 
-			case 'H': 
-			case 'i': 
-			case 'I': 
-			case 'q': 
-			case 'Q': i->print = "%x"; break;
-			case 'f': i->print = "%f"; break;
-			case 'd': i->print = "%lf"; break;
-			case 's': 
-			case 'p': i->print = "%s"; break;
-		}
+	// options modifying another one
+	if (uniq && !sort_keys) {
+		fprintf (stderr, "ERROR: -u allowed only with -S\n");
+		delete (&fmts);
+		return ERR_UNK_OPT;
+	}
+	if (jobs && !diffn) {
+		fprintf (stderr, "ERROR: -j allowed only with -D\n");
+		delete (&fmts);
+		return ERR_UNK_OPT;
+	}
 
-		// parse array notaton
-		if (*fmt == '['){
-			fmt++;
-			char *t = NULL;
-			i->count = strtoul (fmt, &t, 0);
-			if (t && *t != ']') {
-				fprintf (stderr, "ERROR: invalid array notation format!\n");
-				delete (&fmts);
-				return ERR_ARR_FMT;
-			}
-			if (i->count > 65535 || i->count < 1) {
-				fprintf (stderr, "ERROR: array size '%u' invalid\n", i->count);
+	// arrays over ARR_MAX are streamed by plain pack and unpack and by -X
+	for (struct Fmt* i = fmts; i; i = i->next) {
+		if (i->count <= ARR_MAX) continue;
+		if (debug_only || gen_prefix || diffn || sort_keys || trans_fmt || marker || union_tab || follow_file || inputs || every || nsample) {
+			fprintf (stderr, "ERROR: array over %d elements allowed only for pack, -r and -X\n", ARR_MAX);
+			delete (&fmts);
+			return ERR_ARR_FMT;
+		}
+		for (struct Fmt* j = fmts; j; j = j->next) {
+			if (j->format == 'C') {
+				fprintf (stderr, "ERROR: checksum can not cover array over %d elements\n", ARR_MAX);
 				delete (&fmts);
-				return ERR_ARR_FMT;
+				return ERR_CRC_FMT;
 			}
-			fmt = t+1;
 		}
+	}
 
+	// parse in file name
+	if (infn && reverse == 0) {
+		fprintf (stderr, "ERROR: -i allowed only with -r\n");
+		delete (&fmts);
+		return ERR_IN_NAME_ALLOW;
+	}
+	if (infn && reverse == 1) {
+		in = fopen (infn, "rb");
+		if (!in) {
+			fprintf (stderr, "ERROR: could not open file '%s'\n", infn);
+			delete (&fmts);
+			return ERR_OPEN_IN_FILE;
+		}
 	}
 
+	// shm rings instead of -i and -o files
+	if ((ring_i && (infn || follow_file || inputs || diffn)) || (ring_o && outfn)) {
+		fprintf (stderr, "ERROR: -Q excludes -i, -F, -I and -D, -O excludes -o\n");
+		delete (&fmts);
+		return ERR_RING;
+	}
+#ifdef __linux__
+	if (ring_i) in = ring_open (ring_i, 0, 0);
+	if (ring_i && !in) {
+		fprintf (stderr, "ERROR: could not open ring '%s'\n", ring_i);
+		delete (&fmts);
+		return ERR_RING;
+	}
+	if (ring_o) {
+		// size after ':', k m g suffix allowed
+		uint64_t size = 16 << 20;
+		char* t = strchr (ring_o, ':');
+		if (t) {
+			*t++ = '\0';
+			size = strtoull (t, &t, 0);
+			if (*t == 'k' || *t == 'K') size <<= 10;
+			if (*t == 'm' || *t == 'M') size <<= 20;
+			if (*t == 'g' || *t == 'G') size <<= 30;
+		}
+		out = ring_open (ring_o, size, 1);
+		if (!out) {
+			fprintf (stderr, "ERROR: could not open ring '%s'\n", ring_o);
+			fclose (in);
+			delete (&fmts);
+			return ERR_RING;
+		}
+		atexit (ring_exit);
+	}
+#else
+	if (ring_i || ring_o) {
+		fprintf (stderr, "ERROR: -O and -Q need futex (linux)\n");
+		delete (&fmts);
+		return ERR_RING;
+	}
+#endif
 
+	// parse out file name
+	if (outfn) {
+		// checkpointed output is cut at checkpoint below, not here
+		out = ckpt.path ? fopen (outfn, "r+") : NULL;
+		if (!out) out = fopen (outfn, "w");
+		if (!out) {
+			fprintf (stderr, "ERROR: could not open file '%s'\n", outfn);
+			delete (&fmts);
+			return ERR_OPEN_OUT_FILE;
+		}
+	}
 
-	// parse names parameter
-	if (names && reverse == 0) {
-		fprintf (stderr, "ERROR: -n allow only with -r");
-		delete (&fmts);
-		return ERR_NAME_OPT;
+	// resume from checkpoint: seek input, cut output
+	if (ckpt.path) {
+		if (!infn || !outfn || !(trans_fmt || every) || nsample) {
+			fprintf (stderr, "ERROR: -c needs -i and -o files and -r, -T or -e\n");
+			err = ERR_CKPT;
+		}
+		if (!err && ckpt_load (&ckpt)) {
+			fprintf (stderr, "ERROR: checkpoint '%s' is not one of this job\n", ckpt.path);
+			err = ERR_CKPT;
+		}
+		if (!err && (fseeko (in, ckpt.in, SEEK_SET) || ftruncate (fileno (out), ckpt.out) || fseeko (out, ckpt.out, SEEK_SET))) {
+			fprintf (stderr, "ERROR: could not resume from checkpoint '%s'\n", ckpt.path);
+			err = ERR_CKPT;
+		}
+		if (err) {
+			fclose (in);
+			fclose (out);
+			delete (&fmts);
+			return err;
+		}
 	}
-	if (names && reverse == 1) {
-		for (struct Fmt* i = fmts; i; i = i->next) {
-			if (i->format == 'x') continue;
 
-			if (names == NULL) {
-				fprintf (stderr, "ERROR: too few names\n");
+	// generate C code
+	if (gen_prefix) {
+		int valid = (*gen_prefix < '0' || *gen_prefix > '9') && *gen_prefix;
+		for (char* s = gen_prefix; *s; s++)
+			if (!((*s >= 'a' && *s <= 'z') || (*s >= 'A' && *s <= 'Z') || (*s >= '0' && *s <= '9') || *s == '_'))
+				valid = 0;
+		if (!valid) {
+			fprintf (stderr, "ERROR: invalid C identifier '%s'\n", gen_prefix);
+			delete (&fmts);
+			return ERR_GEN_NAME;
+		}
+		for (struct Fmt* i = fmts; i; i = i->next) {
+			if (i->bits) {
+				fprintf (stderr, "ERROR: -G does not support bit fields\n");
 				delete (&fmts);
-				return ERR_NAME_TOO_FEW;
+				return ERR_BIT_FMT;
 			}
-			i->name = names;
-
-			char *t = strchr (names, ',');
-			if (t) {
-				*t = '\0';
-				names = t + 1;
-			} else {
-				names = NULL;
+			if (i->format == 'v' || i->format == 'z') {
+				fprintf (stderr, "ERROR: -G does not support varints\n");
+				delete (&fmts);
+				return ERR_VAR_FMT;
 			}
-
-			size_t l = strlen (i->name);
-			if (max_name_size < l) {
-				max_name_size = l;
+			if (i->format == 'C') {
+				fprintf (stderr, "ERROR: -G does not support checksums\n");
+				delete (&fmts);
+				return ERR_CRC_FMT;
+			}
+			if (i->ts) {
+				fprintf (stderr, "ERROR: -G does not support timestamps\n");
+				delete (&fmts);
+				return ERR_PRINT_INV_FMT;
+			}
+			if (i->shortest) {
+				fprintf (stderr, "ERROR: -G does not support shortest float print 'r'\n");
+				delete (&fmts);
+				return ERR_PRINT_INV_FMT;
+			}
+			if (i->dict) {
+				fprintf (stderr, "ERROR: -G does not support dictionaries\n");
+				delete (&fmts);
+				return ERR_DICT;
 			}
-
-
 		}
-		if (names != NULL) {
-			fprintf (stderr, "ERROR: too much names\n");
+		if (gen (out, fmts, fmt_str, gen_prefix, pad_byte, max_name_size)) {
+			fprintf (stderr, "ERROR: could not allocate memory\n");
 			delete (&fmts);
-			return ERR_NAME_TOO_MUCH;
+			return ERR_ALLOC;
+		}
+		fclose (out);
+		delete (&fmts);
+		return 0;
+	}
 
+	// hexdump input
+	if (hex_only) {
+		if (xdump (in, out, fmts)) {
+			fprintf (stderr, "ERROR: could not allocate memory\n");
+			delete (&fmts);
+			return ERR_ALLOC;
 		}
+		fclose (in);
+		fclose (out);
+		delete (&fmts);
+		return 0;
 	}
 
-	// parse print
-	if (print && reverse == 0) {
-		fprintf (stderr, "ERROR: -p allowed only with -r\n");
+	// compare records of two files
+	if (diffn) {
+		size_t rs = rec_size (fmts);
+		if (rs == 0) {
+			fprintf (stderr, "ERROR: -D needs fixed size fmt (no s p v z)\n");
+			delete (&fmts);
+			return ERR_VAR_FMT;
+		}
+		FILE* b = fopen (diffn, "rb");
+		if (!b) {
+			fprintf (stderr, "ERROR: could not open file '%s'\n", diffn);
+			delete (&fmts);
+			return ERR_OPEN_IN_FILE;
+		}
+		if (cmp_files (in, b, out, fmts, rs, max_name_size, jobs, infn ? infn : "-", diffn)) {
+			fprintf (stderr, "ERROR: could not map input files\n");
+			fclose (b);
+			delete (&fmts);
+			return ERR_MAP_FILE;
+		}
+		fclose (b);
+		fclose (in);
+		fclose (out);
 		delete (&fmts);
-		return ERR_PRINT_OPT;
+		return 0;
 	}
-	if (print && reverse == 1) {
-		for (struct Fmt* i = fmts; i; i = i->next) {
-			if (i->format == 'x') continue;
 
-			if(*print == 0) {
-				fprintf (stderr, "ERROR: too few print formats\n");
+	// sort records by key fields
+	if (sort_keys) {
+		size_t rs = rec_size (fmts);
+		if (rs == 0) {
+			fprintf (stderr, "ERROR: -S needs fixed size fmt (no s p v z)\n");
+			delete (&fmts);
+			return ERR_VAR_FMT;
+		}
+		uint32_t nkeys = 1;
+		for (char* s = sort_keys; *s; s++) nkeys += *s == ',';
+		struct Key* keys = calloc (nkeys, sizeof(struct Key));
+		if (keys == NULL) {
+			fprintf (stderr, "ERROR: could not allocate memory\n");
+			delete (&fmts);
+			return ERR_ALLOC;
+		}
+		size_t kl = 0;
+		char* key = sort_keys;
+		for (uint32_t j = 0; j < nkeys; j++) {
+			char* t = strchr (key, ',');
+			if (t) *t = '\0';
+			size_t off = 0;
+			for (struct Fmt* i = fmts; i; i = i->next) {
+				if (i->name && i->format != 'x' && !i->bits && strcmp (i->name, key) == 0) {
+					keys[j].f = i;
+					keys[j].off = off;
+					kl += fmt_size (i->format) * i->count;
+					break;
+				}
+				off += fmt_bytes (i);
+			}
+			if (keys[j].f == NULL) {
+				fprintf (stderr, "ERROR: unknown sort key '%s' (bit fields not allowed)\n", key);
+				free (keys);
 				delete (&fmts);
-				return ERR_PRINT_TOO_FEW;
+				return ERR_SORT_KEY;
 			}
+			if (t) key = t + 1;
+		}
+		int r = sort_records (in, out, rs, keys, nkeys, kl, uniq, mem);
+		free (keys);
+		delete (&fmts);
+		fclose (in);
+		fclose (out);
+		switch (r) {
+			case -1:
+				fprintf (stderr, "ERROR: could not allocate memory\n");
+				return ERR_ALLOC;
+			case -2:
+				fprintf (stderr, "ERROR: could not read data from input file\n");
+				return ERR_READ_IN;
+			case -3:
+				fprintf (stderr, "ERROR: could not write temporary file\n");
+				return ERR_TMP_FILE;
+		}
+		return 0;
+	}
 
-			// validate format for fmt 
-			switch (i->format) {
-				case 'c':
-					switch (*print) {
-						case 'c': i->print = "%c"; break;
-						default:
-							fprintf (stderr, "ERROR: invalid print format '%c' for '%c' fmt\n", i->format, *print);
-							delete (&fmts);
-							return ERR_PRINT_INV_FMT;
-					}
-					break;
-				case 'b':
-				case 'h':
-				case 'i':
-				case 'q':
-					switch (*print) {
-						case 'd': i->print = "%i"; break;
-						case 'x': i->print = "%x"; break;
-						case 'o': i->print = "%o"; break;
-						case 'b': i->print = "%b"; break;
-						default: {
-							fprintf (stderr, "ERROR: invalid print format '%c' for '%c' fmt\n", i->format, *print);
-							delete (&fmts);
-							return ERR_PRINT_INV_FMT;
-						}
+	// convert records into other layout
+	if (trans_fmt) {
+		struct Fmt* ofmts = NULL;
+		uint32_t ncv = 0, nin = 0, max = 0;
+		err = parse_fmt (trans_fmt, &ofmts);
+		if (!err && trans_names) err = parse_names (ofmts, trans_names, &max);
+		for (struct Fmt* i = ofmts; i; i = i->next) ncv++;
+		for (struct Fmt* i = fmts; i; i = i->next) nin++;
+		struct Conv* cv = calloc (ncv ? ncv : 1, sizeof(struct Conv));
+		if (!err && cv == NULL) {
+			fprintf (stderr, "ERROR: could not allocate memory\n");
+			err = ERR_ALLOC;
+		}
 
-					}
+		// match output fields with input fields by name, or by position
+		uint32_t pos = 0;
+		struct Conv* c = cv;
+		for (struct Fmt* o = ofmts; o && !err; o = o->next, c++) {
+			c->out = o;
+			if (o->format == 'x' || o->format == 'C') continue;
+			uint32_t idx = 0, k = 0;
+			for (struct Fmt* i = fmts; i; i = i->next, idx++) {
+				if (i->format == 'x' || i->format == 'C') continue;
+				if (names && trans_names ? strcmp (i->name, o->name) == 0 : k++ == pos) {
+					c->in = i;
+					c->idx = idx;
 					break;
-				case 'B':
-				case 'H':
-				case 'I':
-				case 'Q':
-					switch (*print) {
-						case 'd': i->print = "%u"; break;
-						case 'x': i->print = "%x"; break;
-						case 'o': i->print = "%o"; break;
-						case 'b': i->print = "%b"; break;
-						default: 
-							fprintf (stderr, "ERROR: invalid print format '%c' for '%c' fmt\n", i->format, *print);
-							delete (&fmts);
-							return ERR_PRINT_INV_FMT;
-						
-					}
+				}
+			}
+			pos++;
+			if (c->in == NULL) {
+				if (o->name) fprintf (stderr, "ERROR: no input field for output field '%s'\n", o->name);
+				else fprintf (stderr, "ERROR: no input field for output field %u\n", pos);
+				err = ERR_TRANS_FMT;
+			} else if (c->in->bits || o->bits) {
+				fprintf (stderr, "ERROR: -T does not support bit fields\n");
+				err = ERR_BIT_FMT;
+			} else if (c->in->count != o->count || (fmt_class (c->in->format) != fmt_class (o->format) &&
+					(!strchr ("suf", fmt_class (c->in->format)) || !strchr ("suf", fmt_class (o->format))))) {
+				fprintf (stderr, "ERROR: can not convert '%c[%zu]' into '%c[%zu]'\n", c->in->format, (size_t)c->in->count, o->format, (size_t)o->count);
+				err = ERR_TRANS_FMT;
+			}
+		}
+
+		if (!err) {
+			uint64_t recno = 0, skipped = 0;
+			struct Conv* bad = NULL;
+			switch (transcode (in, out, fmts, cv, ncv, pad_byte, &recno, &bad, &skipped, ckpt.path ? &ckpt : NULL)) {
+				case -1:
+					fprintf (stderr, "ERROR: could not allocate memory\n");
+					err = ERR_ALLOC;
 					break;
-				case 'f':
-					switch (*print) {
-						case 'f': i->print = "%f"; break;
-						case 'e': i->print = "%e"; break;
-						default:
-							fprintf (stderr, "ERROR: invalid print format '%c' for '%c' fmt\n", i->format, *print);
-							delete (&fmts);
-							return ERR_PRINT_INV_FMT;
-					}
+				case -2:
+					fprintf (stderr, "ERROR: could not read data from input file\n");
+					err = ERR_READ_IN;
 					break;
-				case 'd':
-					switch (*print) {
-						case 'f': i->print = "%lf"; break;
-						case 'e': i->print = "%le"; break;
-						default:
-							fprintf (stderr, "ERROR: invalid print format '%c' for '%c' fmt\n", i->format, *print);
-							delete (&fmts);
-							return ERR_PRINT_INV_FMT;
-					}
+				case -3:
+					if (bad->in->name)
+						fprintf (stderr, "ERROR: record %llu value of '%s' does not fit in '%c'\n", (unsigned long long)recno,
+							bad->in->name, bad->out->format);
+					else
+						fprintf (stderr, "ERROR: record %llu value of field %u does not fit in '%c'\n", (unsigned long long)recno,
+							bad->idx + 1, bad->out->format);
+					err = ERR_RANGE;
 					break;
-				case 's':
-				case 'p':
-					switch (*print) {
-						case 's': i->print = "%s"; break;
-						default:
-							fprintf (stderr, "ERROR: invalid print format '%c' for '%c' fmt\n", i->format, *print);
-							delete (&fmts);
-							return ERR_PRINT_INV_FMT;
-					}
+				case -4:
+					fprintf (stderr, "ERROR: could not write checkpoint '%s'\n", ckpt.path);
+					err = ERR_CKPT;
+					break;
+				case -5:
+					fprintf (stderr, "ERROR: record %llu has fewer bytes than checksum '%s' covers\n", (unsigned long long)recno,
+						bad->out->name ? bad->out->name : "C");
+					err = ERR_CRC_FMT;
 					break;
-
 			}
+			if (skipped) fprintf (stderr, "WARNING: %llu records with bad checksum skipped\n", (unsigned long long)skipped);
+			if (!err && ckpt.path) remove (ckpt.path);
+		}
+		free (cv);
+		delete (&ofmts);
+		delete (&fmts);
+		fclose (in);
+		fclose (out);
+		return err;
+	}
+
+	// length field of -m and -U
+	struct Fmt* len = NULL;
+	if (len_name) {
+		for (struct Fmt* i = fmts; i; i = i->next)
+			if (i->name && strcmp (i->name, len_name) == 0) len = i;
+		if (len == NULL || len->count != 1 || len->bits || !strchr ("su", fmt_class (len->format))) {
+			fprintf (stderr, "ERROR: length field '%s' must be a named single integer\n", len_name);
+			delete (&fmts);
+			return ERR_MARKER;
+		}
+	}
 
-			print++;
+	// decode records found at sync markers
+	if (marker) {
+		uint8_t m[256];
+		size_t ml = 0;
+		for (char* s = marker; *s && ml < sizeof(m); s += 2, ml++) {
+			char x[3] = { s[0], s[1], 0 };
+			char* t = NULL;
+			m[ml] = strtoul (x, &t, 16);
+			if (t != x + 2) {
+				ml = 0;
+				break;
+			}
+		}
+		if (ml == 0 || marker[ml * 2]) {
+			fprintf (stderr, "ERROR: marker '%s' is not 1..256 hex bytes\n", marker);
+			delete (&fmts);
+			return ERR_MARKER;
+		}
+		uint64_t recs = 0, skipped = 0;
+		err = scan (in, out, fmts, m, ml, len, max_name_size, &recs, &skipped);
+		if (err) {
+			fprintf (stderr, "ERROR: could not allocate memory\n");
+			err = ERR_ALLOC;
+		} else {
+			fprintf (stderr, "%llu records, %llu bytes skipped\n", (unsigned long long)recs, (unsigned long long)skipped);
+		}
+		fclose (in);
+		fclose (out);
+		delete (&fmts);
+		return err;
+	}
 
+	// decode records whose body layout is chosen by tag field of header fmt
+	if (union_tab) {
+		struct Fmt* tagf = NULL;
+		for (struct Fmt* i = fmts; i; i = i->next)
+			if (tag_name ? i->name && strcmp (i->name, tag_name) == 0 : tagf == NULL && i->format != 'x') tagf = i;
+		if (tagf == NULL || tagf->count != 1 || tagf->bits || !strchr ("su", fmt_class (tagf->format))) {
+			fprintf (stderr, "ERROR: tag field '%s' must be a single integer\n", tag_name ? tag_name : "");
+			delete (&fmts);
+			return ERR_UNION;
 		}
 
-		if (*print != 0) {
-			fprintf (stderr, "ERROR: too much print formats char.");
+		// "TAG=FMT[:names[:print]];..." each layout parsed once
+		uint32_t nu = 1;
+		for (char* s = union_tab; *s; s++) nu += *s == ';';
+		struct Union* u = calloc (nu, sizeof(struct Union));
+		if (u == NULL) {
+			fprintf (stderr, "ERROR: could not allocate memory\n");
 			delete (&fmts);
-			return ERR_PRINT_TOO_MUCH;
+			return ERR_ALLOC;
+		}
+		char* e = union_tab;
+		for (uint32_t j = 0; j < nu && !err; j++) {
+			char* t = strchr (e, ';');
+			if (t) *t = '\0';
+			char* f = strchr (e, '=');
+			char* bn = f ? strchr (f, ':') : NULL;
+			char* bp = bn ? strchr (bn + 1, ':') : NULL;
+			if (bn) *bn++ = '\0';
+			if (bp) *bp++ = '\0';
+			char* x = NULL;
+			u[j].tag = strtoll (e, &x, 0);
+			if (f == NULL || x != f || f == e) {
+				fprintf (stderr, "ERROR: invalid union entry '%s', use \"TAG=FMT[:names[:print]]\"\n", e);
+				err = ERR_UNION;
+				break;
+			}
+			err = parse_fmt (f + 1, &u[j].fmts);
+			if (!err && bn) err = parse_names (u[j].fmts, bn, &max_name_size);
+			if (!err && bp) err = parse_print (u[j].fmts, bp);
+			if (t) e = t + 1;
+		}
+		if (!err) {
+			qsort (u, nu, sizeof(struct Union), union_cmp);
+			for (uint32_t j = 1; j < nu; j++) {
+				if (u[j].tag == u[j-1].tag) {
+					fprintf (stderr, "ERROR: union tag %lld given twice\n", (long long)u[j].tag);
+					err = ERR_UNION;
+				}
+			}
 		}
+
+		if (!err) {
+			uint64_t recno = 0, unknown = 0;
+			switch (dispatch (in, out, fmts, tagf, len, u, nu, max_name_size, &recno, &unknown)) {
+				case -1:
+					fprintf (stderr, "ERROR: could not allocate memory\n");
+					err = ERR_ALLOC;
+					break;
+				case -2:
+					fprintf (stderr, "ERROR: record %llu is partial or invalid\n", (unsigned long long)recno);
+					err = ERR_READ_IN;
+					break;
+				case -3:
+					fprintf (stderr, "ERROR: record %llu has unknown tag, use -l to skip such\n", (unsigned long long)recno);
+					err = ERR_UNION;
+					break;
+			}
+			if (unknown) fprintf (stderr, "WARNING: %llu records with unknown tag skipped\n", (unsigned long long)unknown);
+		}
+		for (uint32_t j = 0; j < nu; j++) delete (&u[j].fmts);
+		free (u);
+		fclose (in);
+		fclose (out);
+		delete (&fmts);
+		return err;
 	}
-	
 
-	// parse in file name
-	if (infn && reverse == 0) {
-		fprintf (stderr, "ERROR: -i allowed only with -r\n");
+	// decode records appended to file as they come
+	if (follow_file) {
+		if (infn == NULL) {
+			fprintf (stderr, "ERROR: -F needs input file -i\n");
+			delete (&fmts);
+			return ERR_IN_NAME_ALLOW;
+		}
+#ifdef __linux__
+		fclose (in);
+		switch (follow (infn, out, fmts, max_name_size)) {
+			case -1:
+				fprintf (stderr, "ERROR: could not allocate memory\n");
+				err = ERR_ALLOC;
+				break;
+			case -2:
+				fprintf (stderr, "ERROR: could not follow file '%s'\n", infn);
+				err = ERR_READ_IN;
+				break;
+			case -3:
+				fprintf (stderr, "ERROR: invalid record in '%s'\n", infn);
+				err = ERR_RECORD;
+				break;
+		}
+#else
+		fprintf (stderr, "ERROR: -F needs inotify (linux)\n");
+		err = ERR_UNK_OPT;
+#endif
+		fclose (out);
 		delete (&fmts);
-		return ERR_IN_NAME_ALLOW;
+		return err;
 	}
-	if (infn && reverse == 1) {
-		in = fopen (infn, "rb");
-		if (!in) {
-			fprintf (stderr, "ERROR: could not open file '%s'\n", infn);
+
+	// decode records of many inputs as they arrive into one output
+	if (inputs) {
+#ifdef __linux__
+		// "LABEL=PATH[:FMT[:names[:print]]];..." fmt argument when FMT is not given
+		uint32_t ns = 1;
+		for (char* t = inputs; *t; t++) ns += *t == ';';
+		struct Src* src = calloc (ns, sizeof(struct Src));
+		if (src == NULL) {
+			fprintf (stderr, "ERROR: could not allocate memory\n");
 			delete (&fmts);
-			return ERR_OPEN_IN_FILE;
+			return ERR_ALLOC;
+		}
+		char* e = inputs;
+		for (uint32_t j = 0; j < ns && !err; j++) {
+			char* t = strchr (e, ';');
+			if (t) *t = '\0';
+			char* p = strchr (e, '=');
+			char* f = p ? strchr (p, ':') : NULL;
+			char* bn = f ? strchr (f + 1, ':') : NULL;
+			char* bp = bn ? strchr (bn + 1, ':') : NULL;
+			if (f) *f++ = '\0';
+			if (bn) *bn++ = '\0';
+			if (bp) *bp++ = '\0';
+			if (p == NULL || p == e || !p[1] || (bn && !*f)) {
+				fprintf (stderr, "ERROR: invalid input entry '%s', use \"LABEL=PATH[:FMT[:names[:print]]]\"\n", e);
+				err = ERR_INPUT;
+				break;
+			}
+			*p++ = '\0';
+			src[j].label = e;
+			src[j].path = p;
+			src[j].fmts = fmts;
+			if (f && *f) {
+				src[j].fmts = NULL;
+				err = parse_fmt (f, &src[j].fmts);
+				if (!err && bn) err = parse_names (src[j].fmts, bn, &max_name_size);
+				if (!err && bp) err = parse_print (src[j].fmts, bp);
+			}
+			for (struct Fmt* i = src[j].fmts; !err && i; i = i->next) {
+				if (i->count > ARR_MAX) {
+					fprintf (stderr, "ERROR: array over %d elements allowed only for pack, -r and -X\n", ARR_MAX);
+					err = ERR_ARR_FMT;
+				}
+			}
+			if (t) e = t + 1;
+		}
+		uint32_t bad = 0;
+		switch (err ? 0 : mux (out, src, ns, max_name_size, &bad)) {
+			case -1:
+				fprintf (stderr, "ERROR: could not allocate memory\n");
+				err = ERR_ALLOC;
+				break;
+			case -2:
+				fprintf (stderr, "ERROR: could not read input '%s' of '%s' (pipe, FIFO or socket)\n", src[bad].path, src[bad].label);
+				err = ERR_READ_IN;
+				break;
+			case -3:
+				fprintf (stderr, "ERROR: invalid record in input '%s'\n", src[bad].label);
+				err = ERR_RECORD;
+				break;
 		}
+		for (uint32_t j = 0; j < ns; j++)
+			if (src[j].fmts != fmts) delete (&src[j].fmts);
+		free (src);
+#else
+		fprintf (stderr, "ERROR: -I needs epoll (linux)\n");
+		err = ERR_UNK_OPT;
+#endif
+		fclose (in);
+		fclose (out);
+		delete (&fmts);
+		return err;
 	}
 
-	// parse out file name
-	if (outfn) {
-		out = fopen (outfn, "w");
-		if (!out) {
-			fprintf (stderr, "ERROR: could not open file '%s'\n", outfn);
+	// decode every Nth or K random records only
+	if (every || nsample) {
+		if (every && nsample) {
+			fprintf (stderr, "ERROR: -e and -R can not be used together\n");
 			delete (&fmts);
-			return ERR_OPEN_OUT_FILE;
+			return ERR_UNK_OPT;
+		}
+		switch (sample (in, out, fmts, every, nsample, seed, ckpt.path ? &ckpt : NULL, max_name_size)) {
+			case -1:
+				fprintf (stderr, "ERROR: could not allocate memory\n");
+				err = ERR_ALLOC;
+				break;
+			case -2:
+				fprintf (stderr, "ERROR: partial or invalid record in input\n");
+				err = ERR_READ_IN;
+				break;
+			case -4:
+				fprintf (stderr, "ERROR: could not write checkpoint '%s'\n", ckpt.path);
+				err = ERR_CKPT;
+				break;
+		}
+		// finished job starts over next time
+		if (!err && ckpt.path) remove (ckpt.path);
+		fclose (in);
+		fclose (out);
+		delete (&fmts);
+		return err;
+	}
+
+	// read whole record first when it has checksums, verify them on raw bytes
+	// and decode fields from memory
+	uint8_t* rec = NULL;
+	if (reverse == 1) {
+		uint32_t nf = 0, nc = 0;
+		for (struct Fmt* i = fmts; i; i = i->next, nf++) nc += i->format == 'C';
+		if (nc) {
+			size_t cap = 256, n = 0;
+			const uint8_t** at = malloc (nf * sizeof(uint8_t*));
+			rec = malloc (cap);
+			size_t l = rec && at ? rec_read (in, fmts, &rec, &cap, &n) : (size_t)-1;
+			if (l && l != (size_t)-1) {
+				rec_fields (fmts, rec, at);
+				struct Fmt* bad = rec_check (fmts, rec, at);
+				if (bad) {
+					fprintf (stderr, "ERROR: checksum '%s' does not match record\n", bad->name ? bad->name : "C");
+					free (at);
+					free (rec);
+					delete (&fmts);
+					return ERR_CRC;
+				}
+			}
+			free (at);
+			if (n == 0) {
+				fprintf (stderr, "ERROR: could not read data from input file\n");
+				free (rec);
+				delete (&fmts);
+				return ERR_READ_IN;
+			}
+			// partial or invalid record fails in decoding below as without checksums
+			fclose (in);
+			in = fmemopen (rec, n, "rb");
+			if (in == NULL) {
+				fprintf (stderr, "ERROR: could not allocate memory\n");
+				free (rec);
+				delete (&fmts);
+				return ERR_ALLOC;
+			}
 		}
 	}
 
 	// parse val
+	struct Fmt* done = fmts; // fields before it are already written out
 	if (reverse == 0) {
 		for (struct Fmt* i = fmts; i; i = i->next) {
+			if (i->count > ARR_MAX) {
+				for (; done != i; done = done->next)
+					if (done->size) fwrite (done->data, done->size, 1, out);
+				err = arr_pack (out, i, &argv, pad_byte);
+				if (err) {
+					fprintf (stderr, err == -1 ? "ERROR: could not allocate memory\n" : "ERROR: not enough val params\n");
+					delete (&fmts);
+					return err == -1 ? ERR_ALLOC : ERR_VALS_COUNT;
+				}
+				done = i->next;
+				continue;
+			}
 			switch (i->format) {
 				case 'x':
 					i->size = sizeof(uint8_t) * i->count;
@@ -481,8 +4853,8 @@ int main(int argc, char* argv[]) {
 						}
 						int16_t* t = i->data;
 						t[k] = strtol (*argv++, NULL, 0);
-						endian (i->endian, &t[k], 2);
 					}
+					endian (i->endian, i->data, sizeof(int16_t), i->count);
 					break;
 				case 'H':
 					i->size = sizeof(uint16_t) * i->count;
@@ -501,8 +4873,8 @@ int main(int argc, char* argv[]) {
 						}
 						uint16_t* t = i->data;
 						t[k] = strtoul (*argv++, NULL, 0);
-						endian (i->endian, &t[k], 2);
 					}
+					endian (i->endian, i->data, sizeof(uint16_t), i->count);
 					break;
 				case 'i':
 					i->size = sizeof(int32_t) * i->count;
@@ -521,8 +4893,8 @@ int main(int argc, char* argv[]) {
 						}
 						int32_t* t = i->data;
 						t[k] = strtol (*argv++, NULL, 0);
-						endian (i->endian, &t[k], 4);
 					}
+					endian (i->endian, i->data, sizeof(int32_t), i->count);
 					break;
 				case 'I':
 					i->size = sizeof(uint32_t) * i->count;
@@ -541,8 +4913,8 @@ int main(int argc, char* argv[]) {
 						}
 						uint32_t* t = i->data;
 						t[k] = strtoul (*argv++, NULL, 0);
-						endian (i->endian, &t[k], 4);
 					}
+					endian (i->endian, i->data, sizeof(uint32_t), i->count);
 					break;
 				case 'q':
 					i->size = sizeof(int64_t) * i->count;
@@ -561,8 +4933,8 @@ int main(int argc, char* argv[]) {
 						}
 						int64_t* t = i->data;
 						t[k] = strtoll (*argv++, NULL, 0);
-						endian (i->endian, &t[k], 8);
 					}
+					endian (i->endian, i->data, sizeof(int64_t), i->count);
 					break;
 				case 'Q':
 					i->size = sizeof(uint64_t) * i->count;
@@ -581,7 +4953,60 @@ int main(int argc, char* argv[]) {
 						}
 						uint64_t* t = i->data;
 						t[k] = strtoull (*argv++, NULL, 0);
-						endian (i->endian, &t[k], 8);
+					}
+					endian (i->endian, i->data, sizeof(uint64_t), i->count);
+					break;
+				case 'C':
+					// filled when whole record is known, takes no val
+					i->size = sizeof(uint32_t);
+					i->data = calloc (1, i->size);
+					if (i->data == NULL) {
+						fprintf (stderr, "ERROR: could not allocate memory\n");
+						delete (&fmts);
+						return ERR_ALLOC;
+					}
+					break;
+				case 'v':
+				case 'z':
+					i->data = malloc (10 * i->count);
+					if (i->data == NULL) {
+						fprintf (stderr, "ERROR: could not allocate memory\n");
+						delete (&fmts);
+						return ERR_ALLOC;
+					}
+					for (uint32_t k = 0; k < i->count; k++) {
+						if (*argv == NULL) {
+							fprintf (stderr, "ERROR: not enough val params\n");
+							delete (&fmts);
+							return ERR_VALS_COUNT;
+						}
+						uint64_t t = i->format == 'z' ? (uint64_t)strtoll (*argv++, NULL, 0) : strtoull (*argv++, NULL, 0);
+						i->size += varint_put ((uint8_t*)i->data + i->size, t, i->format == 'z');
+					}
+					break;
+				case 't':
+				case 'T':
+					// bytes of whole bit field run are written by its first field
+					if (i->bit == 0) {
+						run = i;
+						i->size = bits_run (i);
+						i->data = malloc (i->size + 9);
+						if (i->data == NULL) {
+							fprintf (stderr, "ERROR: could not allocate memory\n");
+							delete (&fmts);
+							return ERR_ALLOC;
+						}
+						memset (i->data, 0, i->size + 9);
+					}
+					for (uint32_t k = 0; k < i->count; k++) {
+						if (*argv == NULL) {
+							fprintf (stderr, "ERROR: not enough val params\n");
+							delete (&fmts);
+							return ERR_VALS_COUNT;
+						}
+						uint64_t t = i->format == 't' ? (uint64_t)strtoll (*argv++, NULL, 0) : strtoull (*argv++, NULL, 0);
+						bits_put (run->data, i->bit + (uint64_t)k * i->bits, i->bits,
+							(i->endian == '@' ? HOST_ENDIAN : i->endian) == '>', t);
 					}
 					break;
 				case 'f':
@@ -601,8 +5026,8 @@ int main(int argc, char* argv[]) {
 						}
 						float* t = i->data;
 						t[k] = strtof (*argv++, NULL);
-						endian (i->endian, &t[k], 4);
 					}
+					endian (i->endian, i->data, sizeof(float), i->count);
 					break;
 				case 'd':
 					i->size = sizeof(double) * i->count;
@@ -621,8 +5046,8 @@ int main(int argc, char* argv[]) {
 						}
 						double* t = i->data;
 						t[k] = strtod (*argv++, NULL);
-						endian (i->endian, &t[k], 8);
 					}
+					endian (i->endian, i->data, sizeof(double), i->count);
 					break;
 				case 's': 
 					for (uint32_t k = 0; k < i->count; k++) {
@@ -678,6 +5103,21 @@ int main(int argc, char* argv[]) {
 		}
 	} else {
 		for (struct Fmt* i = fmts; i; i = i->next) {
+			if (i->count > ARR_MAX) {
+				for (; done != i; done = done->next) {
+					print_name (out, done, max_name_size);
+					print_values (out, done, done->data);
+					if (done->format != 'x') fprintf (out, "\n");
+				}
+				err = arr_unpack (in, out, i, max_name_size);
+				if (err) {
+					fprintf (stderr, err == -1 ? "ERROR: could not allocate memory\n" : "ERROR: could not read data from input file\n");
+					delete (&fmts);
+					return err == -1 ? ERR_ALLOC : ERR_READ_IN;
+				}
+				done = i->next;
+				continue;
+			}
 			switch (i->format) {
 				case 'x':
 					i->size = sizeof(uint8_t) * i->count;
@@ -688,14 +5128,10 @@ int main(int argc, char* argv[]) {
 						return ERR_ALLOC;
 					}
 					memset (i->data, 0, i->size);
-					for (uint32_t k = 0; k < i->count; k++) {
-						uint8_t* t = i->data;
-						int r = fread (&t[k], 1, 1, in);
-						if (r != 1) {
-							fprintf (stderr, "ERROR: could not read data from input file\n");
-							delete (&fmts);
-							return ERR_READ_IN;
-						}
+					if (fread (i->data, sizeof(uint8_t), i->count, in) != i->count) {
+						fprintf (stderr, "ERROR: could not read data from input file\n");
+						delete (&fmts);
+						return ERR_READ_IN;
 					}
 					break;
 				case 'c':
@@ -707,15 +5143,10 @@ int main(int argc, char* argv[]) {
 						return ERR_ALLOC;
 					}
 					memset (i->data, 0, i->size);
-					for (uint32_t k = 0; k < i->count; k++) {
-						char* t = i->data;
-						int r = fread (&t[k], sizeof(char), 1, in);
-						if (r != 1) {
-							fprintf (stderr, "ERROR: could not read data from input file\n");
-							delete (&fmts);
-							return ERR_READ_IN;
-						}
-						//TODO: think about validating chars
+					if (fread (i->data, sizeof(char), i->count, in) != i->count) {
+						fprintf (stderr, "ERROR: could not read data from input file\n");
+						delete (&fmts);
+						return ERR_READ_IN;
 					}
 					break;
 				case 'b':
@@ -727,14 +5158,10 @@ int main(int argc, char* argv[]) {
 						return ERR_ALLOC;
 					}
 					memset (i->data, 0, i->size);
-					for (uint32_t k = 0; k < i->count; k++) {
-						int8_t* t = i->data;
-						int r = fread (&t[k], sizeof(int8_t), 1, in);
-						if (r != 1) {
-							fprintf (stderr, "ERROR: could not read data from input file\n");
-							delete (&fmts);
-							return ERR_READ_IN;
-						}
+					if (fread (i->data, sizeof(int8_t), i->count, in) != i->count) {
+						fprintf (stderr, "ERROR: could not read data from input file\n");
+						delete (&fmts);
+						return ERR_READ_IN;
 					}
 					break;
 				case 'B':
@@ -746,14 +5173,10 @@ int main(int argc, char* argv[]) {
 						return ERR_ALLOC;
 					}
 					memset (i->data, 0, i->size);
-					for (uint32_t k = 0; k < i->count; k++) {
-						uint8_t* t = i->data;
-						int r = fread (&t[k], sizeof(uint8_t), 1, in);
-						if (r != 1) {
-							fprintf (stderr, "ERROR: could not read data from input file\n");
-							delete (&fmts);
-							return ERR_READ_IN;
-						}
+					if (fread (i->data, sizeof(uint8_t), i->count, in) != i->count) {
+						fprintf (stderr, "ERROR: could not read data from input file\n");
+						delete (&fmts);
+						return ERR_READ_IN;
 					}
 					break;
 				case 'h':
@@ -765,16 +5188,12 @@ int main(int argc, char* argv[]) {
 						return ERR_ALLOC;
 					}
 					memset (i->data, 0, i->size);
-					for (uint32_t k = 0; k < i->count; k++) {
-						int16_t* t = i->data;
-						int r = fread (&t[k], sizeof(int16_t), 1, in);
-						if (r != 1) {
-							fprintf (stderr, "ERROR: could not read data from input file\n");
-							delete (&fmts);
-							return ERR_READ_IN;
-						}
-						endian(i->endian, &t[k], 2);
+					if (fread (i->data, sizeof(int16_t), i->count, in) != i->count) {
+						fprintf (stderr, "ERROR: could not read data from input file\n");
+						delete (&fmts);
+						return ERR_READ_IN;
 					}
+					endian (i->endian, i->data, sizeof(int16_t), i->count);
 					break;
 				case 'H':
 					i->size = sizeof(uint16_t) * i->count;
@@ -785,16 +5204,12 @@ int main(int argc, char* argv[]) {
 						return ERR_ALLOC;
 					}
 					memset (i->data, 0, i->size);
-					for (uint32_t k = 0; k < i->count; k++) {
-						uint16_t* t = i->data;
-						int r = fread (&t[k], sizeof(uint16_t), 1, in);
-						if (r != 1) {
-							fprintf (stderr, "ERROR: could not read data from input file\n");
-							delete (&fmts);
-							return ERR_READ_IN;
-						}
-						endian(i->endian, &t[k], 2);
+					if (fread (i->data, sizeof(uint16_t), i->count, in) != i->count) {
+						fprintf (stderr, "ERROR: could not read data from input file\n");
+						delete (&fmts);
+						return ERR_READ_IN;
 					}
+					endian (i->endian, i->data, sizeof(uint16_t), i->count);
 					break;
 				case 'i':
 					i->size = sizeof(int32_t) * i->count;
@@ -805,18 +5220,15 @@ int main(int argc, char* argv[]) {
 						return ERR_ALLOC;
 					}
 					memset (i->data, 0, i->size);
-					for (uint32_t k = 0; k < i->count; k++) {
-						int32_t* t = i->data;
-						int r = fread (&t[k], sizeof(int32_t), 1, in);
-						if (r != 1) {
-							fprintf (stderr, "ERROR: could not read data from input file. '%d'\n", r);
-							delete (&fmts);
-							return ERR_READ_IN;
-						}
-						endian(i->endian, &t[k], 4);
+					if (fread (i->data, sizeof(int32_t), i->count, in) != i->count) {
+						fprintf (stderr, "ERROR: could not read data from input file\n");
+						delete (&fmts);
+						return ERR_READ_IN;
 					}
+					endian (i->endian, i->data, sizeof(int32_t), i->count);
 					break;
 				case 'I':
+				case 'C':
 					i->size = sizeof(uint32_t) * i->count;
 					i->data = malloc (i->size);
 					if (i->data == NULL) {
@@ -825,16 +5237,12 @@ int main(int argc, char* argv[]) {
 						return ERR_ALLOC;
 					}
 					memset (i->data, 0, i->size);
-					for (uint32_t k = 0; k < i->count; k++) {
-						uint32_t* t = i->data;
-						int r = fread (&t[k], sizeof(uint32_t), 1, in);
-						if (r != 1) {
-							fprintf (stderr, "ERROR: could not read data from input file\n");
-							delete (&fmts);
-							return ERR_READ_IN;
-						}
-						endian(i->endian, &t[k], 4);
+					if (fread (i->data, sizeof(uint32_t), i->count, in) != i->count) {
+						fprintf (stderr, "ERROR: could not read data from input file\n");
+						delete (&fmts);
+						return ERR_READ_IN;
 					}
+					endian (i->endian, i->data, sizeof(uint32_t), i->count);
 					break;
 				case 'q':
 					i->size = sizeof(int64_t) * i->count;
@@ -845,16 +5253,12 @@ int main(int argc, char* argv[]) {
 						return ERR_ALLOC;
 					}
 					memset (i->data, 0, i->size);
-					for (uint32_t k = 0; k < i->count; k++) {
-						int64_t* t = i->data;
-						int r = fread (&t[k], sizeof(int64_t), 1, in);
-						if (r != 1) {
-							fprintf (stderr, "ERROR: could not read data from input file\n");
-							delete (&fmts);
-							return ERR_READ_IN;
-						}
-						endian(i->endian, &t[k], 8);
+					if (fread (i->data, sizeof(int64_t), i->count, in) != i->count) {
+						fprintf (stderr, "ERROR: could not read data from input file\n");
+						delete (&fmts);
+						return ERR_READ_IN;
 					}
+					endian (i->endian, i->data, sizeof(int64_t), i->count);
 					break;
 				case 'Q':
 					i->size = sizeof(uint64_t) * i->count;
@@ -865,17 +5269,64 @@ int main(int argc, char* argv[]) {
 						return ERR_ALLOC;
 					}
 					memset (i->data, 0, i->size);
-					for (uint32_t k = 0; k < i->count; k++) {
-						uint64_t* t = i->data;
-						int r = fread (&t[k], sizeof(uint64_t), 1, in);
-						if (r != 1) {
+					if (fread (i->data, sizeof(uint64_t), i->count, in) != i->count) {
+						fprintf (stderr, "ERROR: could not read data from input file\n");
+						delete (&fmts);
+						return ERR_READ_IN;
+					}
+					endian (i->endian, i->data, sizeof(uint64_t), i->count);
+					break;
+				case 'v':
+				case 'z': {
+					// collect bytes till count varints ended, then decode at once
+					uint8_t* raw = malloc (10 * i->count);
+					i->size = sizeof(uint64_t) * i->count;
+					i->data = malloc (i->size);
+					if (raw == NULL || i->data == NULL) {
+						free (raw);
+						fprintf (stderr, "ERROR: could not allocate memory\n");
+						delete (&fmts);
+						return ERR_ALLOC;
+					}
+					size_t l = 0;
+					for (uint32_t k = 0, m = 0; k < i->count; ) {
+						int c = getc (in);
+						if (c == EOF || m == 10) {
+							free (raw);
+							fprintf (stderr, c == EOF ? "ERROR: could not read data from input file\n" : "ERROR: varint longer than 10 bytes\n");
+							delete (&fmts);
+							return ERR_READ_IN;
+						}
+						raw[l++] = c;
+						m = c & 0x80 ? m + 1 : 0;
+						k += m == 0;
+					}
+					varint_get (i->data, i->count, raw, l, i->format == 'z');
+					free (raw);
+					break; }
+				case 't':
+				case 'T': {
+					// first field of bit field run reads its bytes after own values
+					size_t l = i->bit == 0 ? bits_run (i) : 0;
+					i->size = sizeof(uint64_t) * i->count;
+					i->data = malloc (i->size + l);
+					if (i->data == NULL) {
+						fprintf (stderr, "ERROR: could not allocate memory\n");
+						delete (&fmts);
+						return ERR_ALLOC;
+					}
+					if (i->bit == 0) {
+						run = i;
+						run_len = l;
+						if (fread ((uint8_t*)i->data + i->size, 1, l, in) != l) {
 							fprintf (stderr, "ERROR: could not read data from input file\n");
 							delete (&fmts);
 							return ERR_READ_IN;
 						}
-						endian(i->endian, &t[k], 8);
 					}
-					break;
+					uint8_t* raw = (uint8_t*)run->data + run->size;
+					bits_load (i->data, i, raw + (i->bit + 7) / 8, raw + run_len);
+					break; }
 				case 'f':
 					i->size = sizeof(float) * i->count;
 					i->data = malloc (i->size);
@@ -885,16 +5336,12 @@ int main(int argc, char* argv[]) {
 						return ERR_ALLOC;
 					}
 					memset (i->data, 0, i->size);
-					for (uint32_t k = 0; k < i->count; k++) {
-						float* t = i->data;
-						int r = fread (&t[k], sizeof(float), 1, in);
-						if (r != 1) {
-							fprintf (stderr, "ERROR: could not read data from input file\n");
-							delete (&fmts);
-							return ERR_READ_IN;
-						}
-						endian(i->endian, &t[k], 4);
+					if (fread (i->data, sizeof(float), i->count, in) != i->count) {
+						fprintf (stderr, "ERROR: could not read data from input file\n");
+						delete (&fmts);
+						return ERR_READ_IN;
 					}
+					endian (i->endian, i->data, sizeof(float), i->count);
 					break;
 				case 'd':
 					i->size = sizeof(double) * i->count;
@@ -905,16 +5352,12 @@ int main(int argc, char* argv[]) {
 						return ERR_ALLOC;
 					}
 					memset (i->data, 0, i->size);
-					for (uint32_t k = 0; k < i->count; k++) {
-						double* t = i->data;
-						int r = fread (&t[k], sizeof(double), 1, in);
-						if (r != 1) {
-							fprintf (stderr, "ERROR: could not read data from input file\n");
-							delete (&fmts);
-							return ERR_READ_IN;
-						}
-						endian(i->endian, &t[k], 8);
+					if (fread (i->data, sizeof(double), i->count, in) != i->count) {
+						fprintf (stderr, "ERROR: could not read data from input file\n");
+						delete (&fmts);
+						return ERR_READ_IN;
 					}
+					endian (i->endian, i->data, sizeof(double), i->count);
 					break;
 				case 's': {
 					uint32_t off = 0;
@@ -988,11 +5431,11 @@ int main(int argc, char* argv[]) {
 	
 	if (debug_only){
 		for (struct Fmt* i = fmts; i; i = i->next) {
-			fprintf (stderr, "endian: %c format:%c print_format:'%3s' count:%d name:'%s' data size:%d data ptr:%p\n",
+			fprintf (stderr, "endian: %c format:%c print_format:'%3s' count:%zu name:'%s' data size:%d data ptr:%p\n",
 				i->endian,
 				i->format,
 				i->print,
-				i->count,
+				(size_t)i->count,
 				i->name,
 				i->size,
 				i->data);
@@ -1005,79 +5448,37 @@ int main(int argc, char* argv[]) {
 
 	// print results
 	if (reverse == 0) {
-		for (struct Fmt* i = fmts; i; i = i->next) {
-			fwrite (i->data, i->size, 1, out);
+		size_t n = 0;
+		for (struct Fmt* i = done; i; i = i->next) n += i->size;
+		uint8_t* rec = malloc (n ? n : 1);
+		if (rec == NULL) {
+			fprintf (stderr, "ERROR: could not allocate memory\n");
+			delete (&fmts);
+			return ERR_ALLOC;
 		}
-	} else {
-		for (struct Fmt* i = fmts; i; i = i->next) {
-			uint8_t* d = i->data;
-			size_t r;
-			if (i->name && strlen(i->name) && i->format != 'x'){
-				r = fprintf(out, "%s", i->name);
-				if (max_name_size > r)
-					for (uint32_t x = max_name_size - r; x; x--)
-						fprintf(out, " ");
-				fprintf (out, ": ");
-			}
-
-			for (uint32_t k = 0; k < i->count; k++) {
-				switch (i->format){
-					case 'x':
-						break;
-					case 'c':
-						r = fprintf(out, i->print, *(char*)d);
-						d += sizeof(char);
-						break;
-					case 'b':
-						r = fprintf(out, i->print, *(int8_t*)d);
-						d += sizeof(int8_t);
-						break;
-					case 'B':
-						r = fprintf(out, i->print, *(uint8_t*)d);
-						d += sizeof(uint8_t);
-						break;
-					case 'h':
-						r = fprintf(out, i->print, *(int16_t*)d);
-						d += sizeof(int16_t);
-						break;
-					case 'H':
-						r = fprintf(out, i->print, *(uint16_t*)d);
-						d += sizeof(uint16_t);
-						break;
-					case 'i':
-						r = fprintf(out, i->print, *(int32_t*)d);
-						d += sizeof(int32_t);
-						break;
-					case 'I':
-						r = fprintf(out, i->print, *(uint32_t*)d);
-						d += sizeof(uint32_t);
-						break;
-					case 'q':
-						r = fprintf(out, i->print, *(int64_t*)d);
-						d += sizeof(int64_t);
-						break;
-					case 'Q':
-						r = fprintf(out, i->print, *(uint64_t*)d);
-						d += sizeof(uint64_t);
-						break;
-					case 'f':
-						r = fprintf(out, i->print, *(float*)d);
-						d += sizeof(float);
-						break;
-					case 'd':
-						r = fprintf(out, i->print, *(double*)d);
-						d += sizeof(double);
-						break;
-					case 's':
-					case 'p':
-						r = fprintf(out, i->print, (char*)d);
-						d += r + 1;
-						break;
-
+		// checksums cover bytes of fields before them
+		n = 0;
+		for (struct Fmt* i = done; i; i = i->next) {
+			if (i->format == 'C') {
+				uint32_t v;
+				if (crc_span (i, rec, rec + n, &v)) {
+					fprintf (stderr, "ERROR: record has fewer bytes than checksum '%s' covers\n", i->name ? i->name : "C");
+					free (rec);
+					delete (&fmts);
+					return ERR_CRC_FMT;
 				}
-				if (i->count > 1 && k < i->count-1 && i->format != 'x' && i->format != 'c')
-					fprintf (out, ", ");
+				endian (i->endian, &v, sizeof(v), 1);
+				memcpy (i->data, &v, sizeof(v));
 			}
+			if (i->size) memcpy (rec + n, i->data, i->size);
+			n += i->size;
+		}
+		fwrite (rec, n, 1, out);
+		free (rec);
+	} else {
+		for (struct Fmt* i = done; i; i = i->next) {
+			print_name (out, i, max_name_size);
+			print_values (out, i, i->data);
 			if (i->format != 'x') fprintf (out, "\n");
 			
 		}
@@ -1085,6 +5486,7 @@ int main(int argc, char* argv[]) {
 
 	fclose(in);
 	fclose(out);
+	free (rec);
 	delete (&fmts);
 	return 0;
 
@@ -1119,33 +5521,114 @@ const char* usage =
 "      d   double\n"
 "      s   c string\n"
 "      p   pascal string\n"
+"      t   signed bit field, width \"{1..64}\" follows, Ex: t{3}\n"
+"      T   unsigned bit field, width \"{1..64}\" follows, Ex: T{12}[4]\n"
+"          bit fields following each other share bytes, run of them is\n"
+"          padded to whole byte. > is MSB-first, < LSB-first bit order\n"
+"      v   unsigned LEB128 varint (1..10 bytes, uint64_t)\n"
+"      z   signed zigzag LEB128 varint (1..10 bytes, int64_t)\n"
+"      C   CRC32C (uint32_t) of all record bytes before it, or of last N\n"
+"          with \"{N}\", Ex: C{16}. takes no val, verified by -r and -T\n"
 "    array (optional):\n"
 "      use \"[N]\" array notation to indicate an array of values.\n"
-"      N is limited up to 65535\n"
+"      N is limited up to 65535, except for x c b B h H i I q Q f d\n"
+"      whose long arrays are streamed in chunks by pack, -r and -X\n"
 "\n"
+;
+
+const char* usage_opt = 
 "  opt:\n"
 "   -r      reverse - unpack insteadof pack\n"
 "   -v      print version and quit\n"
 "   -d      debug only. parse enveything but not print output, just debug info.\n"
+"   -X      hexdump whole input, bytes starting a field of fmt (repeated till\n"
+"           end of input) are marked with '|'. implies -r\n"
+"   -D STR  compare fixed size records of input with file STR and print\n"
+"           differing fields as \"[record] name: old -> new\". implies -r\n"
+"   -j N    number of threads for -D (1 by default)\n"
+"   -S STR  sort fixed size records of input by comma separated key fields\n"
+"           named with -n and write them to output. implies -r\n"
+"   -u      with -S write only first record of every key\n"
+"   -M N    memory limit for -S, k m g suffix allowed (256m by default).\n"
+"           larger input is sorted in temporary files and merged\n"
+"   -T STR  convert records of input into records of fmt STR and write them\n"
+"           to output. fields are matched by position, or by name when -n\n"
+"           and -N are given, unmatched input fields are dropped. numbers\n"
+"           are swapped, widened or narrowed (range checked). implies -r\n"
+"           records with bad checksum are skipped\n"
+"   -N STR  comma separated names of -T fmt fields (exclude x)\n"
+"   -m HEX  scan input for marker bytes, Ex: -m a55a, and decode record of fmt\n"
+"           starting at every match, printed as \"[offset] name: value\".\n"
+"           matches whose record is cut, invalid or has bad checksum are\n"
+"           passed over, bytes outside records are counted. implies -r\n"
+"   -l STR  with -m and -U, field STR holds number of record bytes after it\n"
+"   -U STR  records are fmt header and body chosen by header tag field from\n"
+"           \"TAG=FMT[:names[:print]];...\", Ex: -U \"1=<Hf:id,val;2=s\". printed\n"
+"           as \"[record] name: value\". unknown tags are skipped with -l.\n"
+"           implies -r\n"
+"   -k STR  tag field of -U header (first field by default)\n"
+"   -f STR  schema file, fmt argument is then name of its schema given as\n"
+"           \"[name]\" line followed by \"fmt = ...\", \"names = ...\" and\n"
+"           \"print = ...\" lines (repeated ones are joined, # comments).\n"
+"           compiled schema is cached in ~/.cache/sp by hash of its text\n"
+"   -F      follow -i file: decode all its records as \"[record] name: value\",\n"
+"           then wait for appended ones like tail -F. partial record is held\n"
+"           back till complete, rotated or truncated file is followed from\n"
+"           start. implies -r\n"
+"   -I STR  decode records of many pipes, FIFOs or sockets as they arrive,\n"
+"           given as \"LABEL=PATH[:FMT[:names[:print]]];...\" (fmt argument,\n"
+"           -n and -p when FMT is not given), printed to one output as\n"
+"           \"[LABEL record] name: value\". ends when all writers did.\n"
+"           implies -r\n"
+"   -e N    decode every Nth record only, printed as \"[record] name: value\".\n"
+"           implies -r\n"
+"   -R K    decode K records picked uniformly at random, in input order,\n"
+"           printed as \"[record] name: value\". fixed size records of a\n"
+"           file are read directly, other input is read through. implies -r\n"
+"   -s N    seed of -R (1 by default). file of fixed size records is sampled\n"
+"           otherwise than pipe, same seed repeats picks of same kind of input\n"
+"   -c STR  checkpoint file of -T and -e with -i and -o files, written every\n"
+"           N records of STR[:N] (1048576 by default). rerun resumes from it,\n"
+"           output is cut back to it. removed when done. plain -r decodes\n"
+"           all records with it, as -e 1\n"
+;
+
+const char* usage_io = 
 "   -i STR  input stream file (stdin by default). only with -r\n"
 "   -o STR  output stream file (stdout by default)\n"
+"   -O STR  write output into shared memory ring STR[:SIZE] instead, k m g\n"
+"           suffix allowed (16m by default). created when missing\n"
+"   -Q STR  read input from shared memory ring STR of -O. implies -r\n"
 "   -x XX   pad byte value. ignored for -r.\n"
 "   -n STR  comma separated struct names for each fmt (exclude x). only with -r\n"
 "           otherwise skipped, Ex: -n \"id,first name,age\"\n"
 "   -p STR  print format for each fmt. only with -r\n"
 "           fmt: c\n"
 "             c   char\n"
-"           fmt: b h i q B H I Q \n"
+"           fmt: b h i q t z B H I Q T v C\n"
 "             d   decimal\n"
 "             x   hexadecimal (default)\n"
 "             o   octal\n"
 "             b   binary\n"
+"             any of them followed by \"{FILE}\" prints names of values\n"
+"             from dictionary FILE of \"VALUE NAME\" lines (# comments)\n"
+"             instead, other values as numbers, Ex: -p \"d{types.txt}x\"\n"
+"             S   ISO-8601 time of epoch seconds, Ex: 2024-03-05T12:34:56Z\n"
+"             M   same of epoch milliseconds, U microseconds, N nanoseconds\n"
+"                 \"{+HH:MM}\" after S M U N sets offset from UTC up to 14:00,\n"
+"                 Ex: N{-05:00}, times outside years 0000-9999 as numbers\n"
 "           fmt: f d\n"
 "             f   floating point\n"
 "             e   science  notation\n"
+"             r   shortest that reads back into same value\n"
 "           fmt: s p\n"
 "             s   string\n"
+"   -G STR  generate C header with packed struct STR and STR_pack, STR_unpack,\n"
+"           STR_print functions for fmt. -n and -p are allowed, no val's\n"
 "\n"
+;
+
+const char* usage_val = 
 "  val:\n"
 "    Allow to pass values as numbers, string or bytes.\n"
 "    Example: 123, 0b111, 0o672, 0xab1, \"def ine\"\n"
@@ -0,0 +1,52 @@
+#!/bin/sh
+# regression checks of sp, run by make check
+SP=${SP:-./sp}
+T=$(mktemp -d)
+trap 'rm -rf "$T"' EXIT
+export XDG_CACHE_HOME="$T/cache"
+fail=0
+
+# expect NAME WANT GOT
+expect() {
+	if [ "$2" = "$3" ]; then
+		echo "ok   $1"
+	else
+		echo "FAIL $1"
+		echo "  want: $2" | head -5
+		echo "  got:  $3" | head -5
+		fail=1
+	fi
+}
+
+# -p replaces timestamp, shortest and dictionary print of schema
+printf '1 one\n' > "$T/d.txt"
+printf '[a]\nfmt = <IdI\nprint = S{+01:00}rd{%s}\n' "$T/d.txt" > "$T/s"
+$SP "<IdI" 1 0.1 1 > "$T/r"
+expect "schema print" "$(printf '1970-01-01T01:00:01+01:00\n0.1\none')" "$($SP -r -i "$T/r" -f "$T/s" a)"
+expect "-p over schema print" "$(printf '1\n1.000000e-01\n1')" "$($SP -r -i "$T/r" -f "$T/s" -p ded a)"
+expect "-p over cached schema print" "$(printf '1\n1.000000e-01\n1')" "$($SP -r -i "$T/r" -f "$T/s" -p ded a)"
+
+# times outside years 0000-9999 print as numbers
+$SP "<QQq" 9223372036854775807 18446744073709551615 -1 > "$T/r"
+expect "timestamp range" "$(printf '9223372036854775807\n18446744073709551615\n1969-12-31T22:59:59-01:00')" "$($SP -r -i "$T/r" -p "S{+01:00}S{+01:00}S{-01:00}" "<QQq")"
+# -T truncates before range check, names unnamed field by number, takes empty fmt
+$SP "<dd" -128.9 1 > "$T/r"
+$SP -T "<bb" -i "$T/r" -o "$T/o" "<dd"
+expect "-T truncation" "$(printf -- '-128\n1')" "$($SP -r -i "$T/o" -p dd "<bb")"
+$SP "<dd" 1 -129 > "$T/r"
+expect "-T range error" "ERROR: record 0 value of field 2 does not fit in 'b'" "$($SP -T "<bb" -i "$T/r" -o "$T/o" "<dd" 2>&1)"
+expect "-T empty fmt" "0" "$($SP -T "" -i "$T/r" -o "$T/o" "<dd" && wc -c < "$T/o")"
+# -c of plain -r decodes all records, key takes whole -n and -p
+for v in 1 2 3 4 5; do $SP "<Ic" $v a; done > "$T/r"
+head -c 22 "$T/r" > "$T/h"
+$SP -r -c "$T/ck:2" -i "$T/h" -o "$T/o" -n "n,c" -p dc "<Ic" 2> /dev/null
+expect "-c other -n" "ERROR: checkpoint '$T/ck' is not one of this job" "$($SP -r -c "$T/ck:2" -i "$T/r" -o "$T/o" -n "n,d" -p dc "<Ic" 2>&1)"
+$SP -r -c "$T/ck:2" -i "$T/r" -o "$T/o" -n "n,c" -p dc "<Ic"
+expect "-r -c resume" "$($SP -e 1 -i "$T/r" -n "n,c" -p dc "<Ic")" "$(cat "$T/o")"
+# shortest float print where Grisu2 alone is not shortest
+$SP "<ddddf" 1e23 5e-324 8.41e21 1.70669958771192e-22 1e23 > "$T/r"
+expect "shortest print" "$(printf '1e+23\n5e-324\n8.41e+21\n1.70669958771192e-22\n1e+23')" "$($SP -r -i "$T/r" -p rrrrr "<ddddf")"
+# CRC32C of a span long enough for the 3 lane pclmul fold
+$SP "<B[7000]C" $(seq 0 6999 | awk '{ print $1 % 251 }') > "$T/r"
+expect "long span checksum" "370799884" "$(tail -c 4 "$T/r" | $SP -r -p d "<I")"
+exit $fail